@@ -0,0 +1,79 @@
+#include "Arena.h"
+
+#include <algorithm>
+#include <new>
+
+
+//-- blocks kept after a rewind to the start; beyond that (a huge shell) they
+//-- are given back to the system
+const std::size_t ARENA_MAX_KEPT = std::size_t(64) << 20;
+
+
+Arena::Arena(std::size_t blocksize) {
+  _blocksize = blocksize;
+  _current = 0;
+  _offset = 0;
+}
+
+Arena::~Arena() {
+  for (auto& b : _blocks) {
+    ::operator delete(b.data);
+  }
+}
+
+void*
+Arena::allocate(std::size_t n, std::size_t align) {
+  n = std::max(n, std::size_t(1));
+  while (_current < _blocks.size()) {
+    Block& b = _blocks[_current];
+    std::size_t start = (_offset + align - 1) & ~(align - 1);
+    if (start + n <= b.size) {
+      _offset = start + n;
+      return b.data + start;
+    }
+    _current += 1;
+    _offset = 0;
+  }
+  //-- a new block, larger if the request is (operator new aligns for any type)
+  Block b;
+  b.size = std::max(_blocksize, n);
+  b.data = static_cast<char*>(::operator new(b.size));
+  _blocks.push_back(b);
+  _current = _blocks.size() - 1;
+  _offset = n;
+  return b.data;
+}
+
+Arena::Mark
+Arena::mark() const {
+  Mark m;
+  m.block = _current;
+  m.offset = _offset;
+  return m;
+}
+
+void
+Arena::rewind(const Mark& m) {
+  _current = m.block;
+  _offset = m.offset;
+  if ( (m.block == 0) && (m.offset == 0) && (capacity() > ARENA_MAX_KEPT) ) {
+    for (std::size_t i = 1; i < _blocks.size(); i++) {
+      ::operator delete(_blocks[i].data);
+    }
+    _blocks.resize(std::min(_blocks.size(), std::size_t(1)));
+  }
+}
+
+std::size_t
+Arena::capacity() const {
+  std::size_t total = 0;
+  for (auto& b : _blocks) {
+    total += b.size;
+  }
+  return total;
+}
+
+Arena& scratch_arena() {
+  static thread_local Arena arena;
+  return arena;
+}
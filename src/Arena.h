@@ -0,0 +1,100 @@
+#ifndef __Arena__
+#define __Arena__
+
+#include <cstddef>
+#include <functional>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+
+//-- monotonic arena for the temporaries of a face or a shell: allocating is
+//-- a pointer bump in a block, freeing one object does nothing, and all is
+//-- given back at once when the ArenaScope that opened it is closed. The
+//-- blocks are kept, so after the first shells a thread does not allocate
+//-- anymore. One arena per thread (scratch_arena()), so no contention.
+class Arena {
+public:
+  struct Mark {
+    std::size_t         block;
+    std::size_t         offset;
+  };
+
+  explicit Arena(std::size_t blocksize = std::size_t(1) << 16);
+  ~Arena();
+  Arena(const Arena&) = delete;
+  Arena& operator=(const Arena&) = delete;
+
+  void*                 allocate(std::size_t n, std::size_t align);
+  Mark                  mark() const;
+  //-- everything allocated since m is released (the blocks are kept)
+  void                  rewind(const Mark& m);
+  std::size_t           capacity() const;
+
+private:
+  struct Block {
+    char*               data;
+    std::size_t         size;
+  };
+
+  std::vector<Block>    _blocks;
+  std::size_t           _current;
+  std::size_t           _offset;
+  std::size_t           _blocksize;
+};
+
+//-- the arena of the calling thread
+Arena&                  scratch_arena();
+
+//-- the allocations made in the arena while the scope is open are released
+//-- when it is closed; scopes nest (the containers must be declared after
+//-- the scope, so that they are destroyed before it)
+class ArenaScope {
+public:
+  explicit ArenaScope(Arena& arena = scratch_arena()) : _arena(arena), _mark(arena.mark()) {}
+  ~ArenaScope() { _arena.rewind(_mark); }
+  ArenaScope(const ArenaScope&) = delete;
+  ArenaScope& operator=(const ArenaScope&) = delete;
+
+private:
+  Arena&                _arena;
+  Arena::Mark           _mark;
+};
+
+//-- allocator of the std containers; by default in the arena of the thread
+//-- that builds the container (do not grow it from another thread)
+template <typename T>
+class ArenaAllocator {
+public:
+  typedef T             value_type;
+
+  ArenaAllocator() : _arena(&scratch_arena()) {}
+  explicit ArenaAllocator(Arena& arena) : _arena(&arena) {}
+  template <typename U>
+  ArenaAllocator(const ArenaAllocator<U>& other) : _arena(other.arena()) {}
+
+  T* allocate(std::size_t n) {
+    return static_cast<T*>(_arena->allocate(n * sizeof(T), alignof(T)));
+  }
+  void deallocate(T*, std::size_t) {}
+  Arena* arena() const { return _arena; }
+
+private:
+  Arena*                _arena;
+};
+
+template <typename T, typename U>
+bool operator==(const ArenaAllocator<T>& a, const ArenaAllocator<U>& b) { return a.arena() == b.arena(); }
+template <typename T, typename U>
+bool operator!=(const ArenaAllocator<T>& a, const ArenaAllocator<U>& b) { return a.arena() != b.arena(); }
+
+template <typename T>
+using ArenaVector = std::vector<T, ArenaAllocator<T>>;
+template <typename K, typename V, typename H = std::hash<K>>
+using ArenaUnorderedMap = std::unordered_map<K, V, H, std::equal_to<K>, ArenaAllocator<std::pair<const K, V>>>;
+template <typename K, typename V, typename H = std::hash<K>>
+using ArenaUnorderedMultimap = std::unordered_multimap<K, V, H, std::equal_to<K>, ArenaAllocator<std::pair<const K, V>>>;
+template <typename K, typename H = std::hash<K>>
+using ArenaUnorderedSet = std::unordered_set<K, H, std::equal_to<K>, ArenaAllocator<K>>;
+
+#endif
@@ -0,0 +1,73 @@
+#ifndef __Philox__
+#define __Philox__
+
+#include <cstdint>
+
+//-- counter-based random generator Philox4x32-10 (Salmon et al., SC'11).
+//-- the n-th number of a stream is a pure function of (key, stream, n), so
+//-- streams can be handed to threads/blocks and the results do not depend
+//-- on the scheduling. Same API as CGAL::Random for what we use.
+class Philox {
+public:
+  Philox(std::uint64_t key, std::uint64_t stream) {
+    _key[0] = std::uint32_t(key);
+    _key[1] = std::uint32_t(key >> 32);
+    _ctr[0] = 0;
+    _ctr[1] = 0;
+    _ctr[2] = std::uint32_t(stream);
+    _ctr[3] = std::uint32_t(stream >> 32);
+    _n = 4;
+  }
+
+  std::uint32_t get_uint32() {
+    if (_n == 4) {
+      generate();
+      _n = 0;
+    }
+    return _out[_n++];
+  }
+
+  //-- in [0, 1), 53 bits
+  double get_double() {
+    std::uint64_t a = get_uint32() >> 5;
+    std::uint64_t b = get_uint32() >> 6;
+    return (a * 67108864.0 + b) * (1.0 / 9007199254740992.0);
+  }
+
+  double uniform_real(double lo, double hi) {
+    return lo + (hi - lo) * get_double();
+  }
+
+private:
+  std::uint32_t   _key[2];
+  std::uint32_t   _ctr[4];
+  std::uint32_t   _out[4];
+  int             _n;
+
+  void generate() {
+    std::uint32_t c[4] = {_ctr[0], _ctr[1], _ctr[2], _ctr[3]};
+    std::uint32_t k0 = _key[0];
+    std::uint32_t k1 = _key[1];
+    for (int r = 0; r < 10; r++) {
+      std::uint64_t p0 = std::uint64_t(0xD2511F53) * c[0];
+      std::uint64_t p1 = std::uint64_t(0xCD9E8D57) * c[2];
+      std::uint32_t n0 = std::uint32_t(p1 >> 32) ^ c[1] ^ k0;
+      std::uint32_t n2 = std::uint32_t(p0 >> 32) ^ c[3] ^ k1;
+      c[0] = n0;
+      c[1] = std::uint32_t(p1);
+      c[2] = n2;
+      c[3] = std::uint32_t(p0);
+      k0 += 0x9E3779B9;
+      k1 += 0xBB67AE85;
+    }
+    for (int i = 0; i < 4; i++) {
+      _out[i] = c[i];
+    }
+    //-- next counter (the 2 low words, the 2 high ones are the stream)
+    if (++_ctr[0] == 0) {
+      ++_ctr[1];
+    }
+  }
+};
+
+#endif
@@ -0,0 +1,43 @@
+#include "Pipeline.h"
+
+#include <iomanip>
+
+
+//-- one line per stage; the bottleneck is the stage with the highest
+//-- utilisation (time busy / (workers * wall time)).
+//-- items/s is what the stage could sustain with its workers if never starved
+void print_stage_stats(std::ostream& os, const std::vector<std::unique_ptr<StageStats>>& stats, double wall) {
+  os << std::left << std::setw(14) << "stage" << std::right
+     << std::setw(8) << "workers"
+     << std::setw(10) << "items"
+     << std::setw(10) << "busy[s]"
+     << std::setw(9) << "util[%]"
+     << std::setw(11) << "items/s"
+     << std::setw(12) << "starved[s]"
+     << std::setw(12) << "blocked[s]"
+     << "  queue avg/max/cap" << std::endl;
+  std::string bottleneck;
+  double maxutil = -1.0;
+  for (auto& s : stats) {
+    double busy = double(s->busy) / 1e9;
+    double util = (wall > 0.0) ? (busy / (s->workers * wall)) : 0.0;
+    double rate = (busy > 0.0) ? (s->items * s->workers / busy) : 0.0;
+    if (util > maxutil) {
+      maxutil = util;
+      bottleneck = s->name;
+    }
+    os << std::left << std::setw(14) << s->name << std::right << std::fixed
+       << std::setw(8) << s->workers
+       << std::setw(10) << s->items
+       << std::setw(10) << std::setprecision(2) << busy
+       << std::setw(9) << std::setprecision(1) << 100.0 * util
+       << std::setw(11) << std::setprecision(1) << rate
+       << std::setw(12) << std::setprecision(2) << double(s->starved) / 1e9
+       << std::setw(12) << std::setprecision(2) << double(s->blocked) / 1e9;
+    if (s->queue_capacity > 0) {
+      os << "  " << std::setprecision(1) << s->queue_avg << "/" << s->queue_max << "/" << s->queue_capacity;
+    }
+    os << std::endl;
+  }
+  os << "wall time: " << std::setprecision(2) << wall << "s, bottleneck: " << bottleneck << std::endl;
+}
@@ -0,0 +1,237 @@
+#ifndef __Pipeline__
+#define __Pipeline__
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+
+//-- FIFO queue between two stages, push() blocks while it is full
+template <typename T>
+class BoundedQueue {
+public:
+  BoundedQueue(std::size_t capacity, int nproducers) {
+    _capacity = std::max(std::size_t(1), capacity);
+    _nproducers = nproducers;
+  }
+
+  void push(T item) {
+    std::unique_lock<std::mutex> lock(_mutex);
+    _notfull.wait(lock, [this]() { return _items.size() < _capacity; });
+    _items.push_back(std::move(item));
+    _npush += 1;
+    _depthsum += _items.size();
+    _maxdepth = std::max(_maxdepth, _items.size());
+    _notempty.notify_one();
+  }
+
+  //-- blocks while it is empty, false once all producers are done and it is drained
+  bool pop(T& item) {
+    std::unique_lock<std::mutex> lock(_mutex);
+    _notempty.wait(lock, [this]() { return (_items.empty() == false) || (_nproducers == 0); });
+    if (_items.empty() == true) {
+      return false;
+    }
+    item = std::move(_items.front());
+    _items.pop_front();
+    _notfull.notify_one();
+    return true;
+  }
+
+  void producer_done() {
+    std::lock_guard<std::mutex> lock(_mutex);
+    _nproducers -= 1;
+    if (_nproducers == 0) {
+      _notempty.notify_all();
+    }
+  }
+
+  std::size_t capacity() { return _capacity; }
+  std::size_t max_depth() { return _maxdepth; }
+  double      avg_depth() { return (_npush == 0) ? 0.0 : (double(_depthsum) / _npush); }
+
+private:
+  std::mutex                _mutex;
+  std::condition_variable   _notfull;
+  std::condition_variable   _notempty;
+  std::deque<T>             _items;
+  std::size_t               _capacity;
+  int                       _nproducers;
+  std::size_t               _npush = 0;
+  std::size_t               _depthsum = 0;
+  std::size_t               _maxdepth = 0;
+};
+
+
+//-- what is observed for one stage (and its input queue)
+struct StageStats {
+  std::string               name;
+  int                       workers = 1;
+  std::atomic<std::size_t>  items{0};
+  std::atomic<long long>    busy{0};      //-- ns in the stage function (all workers)
+  std::atomic<long long>    starved{0};   //-- ns waiting for input
+  std::atomic<long long>    blocked{0};   //-- ns waiting for room in the output queue
+  std::size_t               queue_capacity = 0;
+  std::size_t               queue_max = 0;
+  double                    queue_avg = 0.0;
+};
+
+void    print_stage_stats(std::ostream& os, const std::vector<std::unique_ptr<StageStats>>& stats, double wall);
+
+
+//-- items of type T go through a source (1 thread) and then a chain of stages,
+//-- each with its own number of workers, connected by bounded queues.
+//-- the items are never dropped: every item reaches the last stage.
+//-- an exception in a stage stops the processing (the items are drained,
+//-- only the last stage still runs) and is rethrown by run(); the errors of
+//-- the items themselves should be handled in the stages.
+template <typename T>
+class Pipeline {
+public:
+  Pipeline(std::size_t queuesize) {
+    _queuesize = queuesize;
+    _failed = false;
+  }
+
+  void source(const std::string& name, std::function<void(const std::function<void(T)>&)> f) {
+    _source = f;
+    _stats.emplace_back(new StageStats());
+    _stats.back()->name = name;
+  }
+
+  void stage(const std::string& name, int nworkers, std::function<void(T&)> f) {
+    _stages.push_back(f);
+    _stats.emplace_back(new StageStats());
+    _stats.back()->name = name;
+    _stats.back()->workers = std::max(1, nworkers);
+  }
+
+  int nworkers() {
+    int n = 0;
+    for (auto& s : _stats) {
+      n += s->workers;
+    }
+    return n;
+  }
+
+  void run() {
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::unique_ptr<BoundedQueue<T>>> queues;
+    for (std::size_t i = 0; i < _stages.size(); i++) {
+      queues.emplace_back(new BoundedQueue<T>(_queuesize, _stats[i]->workers));
+    }
+    std::vector<std::thread> threads;
+    //-- source
+    threads.emplace_back([this, &queues]() {
+      StageStats& st = *_stats[0];
+      BoundedQueue<T>* out = queues.empty() ? nullptr : queues[0].get();
+      auto t0 = std::chrono::steady_clock::now();
+      long long waiting = 0;
+      try {
+        _source([&](T item) {
+          st.items += 1;
+          if (out != nullptr) {
+            auto t1 = std::chrono::steady_clock::now();
+            out->push(std::move(item));
+            waiting += elapsed(t1);
+          }
+        });
+      } catch (...) {
+        fail(std::current_exception());
+      }
+      st.busy += elapsed(t0) - waiting;
+      st.blocked += waiting;
+      if (out != nullptr) {
+        out->producer_done();
+      }
+    });
+    //-- stages
+    for (std::size_t i = 0; i < _stages.size(); i++) {
+      for (int w = 0; w < _stats[i + 1]->workers; w++) {
+        threads.emplace_back([this, &queues, i]() {
+          StageStats& st = *_stats[i + 1];
+          BoundedQueue<T>* in = queues[i].get();
+          BoundedQueue<T>* out = (i + 1 < queues.size()) ? queues[i + 1].get() : nullptr;
+          while (true) {
+            T item;
+            auto t0 = std::chrono::steady_clock::now();
+            if (in->pop(item) == false) {
+              break;
+            }
+            st.starved += elapsed(t0);
+            //-- after a failure the items are drained, but the last stage
+            //-- (the sink) still gets them: what is done is not lost
+            if ( (_failed == false) || (i + 1 == _stages.size()) ) {
+              auto t1 = std::chrono::steady_clock::now();
+              try {
+                _stages[i](item);
+              } catch (...) {
+                fail(std::current_exception());
+              }
+              st.busy += elapsed(t1);
+            }
+            st.items += 1;
+            if (out != nullptr) {
+              auto t2 = std::chrono::steady_clock::now();
+              out->push(std::move(item));
+              st.blocked += elapsed(t2);
+            }
+          }
+          if (out != nullptr) {
+            out->producer_done();
+          }
+        });
+      }
+    }
+    for (auto& t : threads) {
+      t.join();
+    }
+    _wall = double(elapsed(start)) / 1e9;
+    for (std::size_t i = 0; i < queues.size(); i++) {
+      _stats[i + 1]->queue_capacity = queues[i]->capacity();
+      _stats[i + 1]->queue_max = queues[i]->max_depth();
+      _stats[i + 1]->queue_avg = queues[i]->avg_depth();
+    }
+    if (_eptr != nullptr) {
+      std::rethrow_exception(_eptr);
+    }
+  }
+
+  void report(std::ostream& os) {
+    print_stage_stats(os, _stats, _wall);
+  }
+
+private:
+  std::size_t                                       _queuesize;
+  std::function<void(const std::function<void(T)>&)> _source;
+  std::vector<std::function<void(T&)>>              _stages;
+  std::vector<std::unique_ptr<StageStats>>          _stats;
+  std::atomic<bool>                                 _failed;
+  std::exception_ptr                                _eptr = nullptr;
+  std::mutex                                        _emutex;
+  double                                            _wall = 0.0;
+
+  void fail(std::exception_ptr e) {
+    std::lock_guard<std::mutex> lock(_emutex);
+    if (_eptr == nullptr) {
+      _eptr = e;
+    }
+    _failed = true;
+  }
+
+  static long long elapsed(std::chrono::steady_clock::time_point t) {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - t).count();
+  }
+};
+
+#endif
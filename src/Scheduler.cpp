@@ -0,0 +1,234 @@
+#include "Scheduler.h"
+#include "parallel.h"
+#include "Workspace.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <exception>
+#include <limits>
+#include <numeric>
+#include <unordered_map>
+
+
+//-- rough estimates for one shell, using only what is known before building
+//-- the Shell: the number of triangles, the surface area, the volume of the
+//-- bbox (upper bound of the volume) and whether the triangle soup is closed
+//-- (otherwise hole filling and alpha-wrapping).
+//-- cost is in arbitrary units, memory is the peak footprint in bytes.
+ShellEstimate estimate_shell(const std::vector<Triangle>& trs, const std::vector<Point3>& lspts) {
+  double inf = std::numeric_limits<double>::max();
+  double xmin = inf, ymin = inf, zmin = inf;
+  double xmax = -inf, ymax = -inf, zmax = -inf;
+  double area = 0.0;
+  std::unordered_map<std::uint64_t, int> edges;
+  edges.reserve(trs.size() * 2);
+  for (auto& tr : trs) {
+    for (int k = 0; k < 3; k++) {
+      const Point3& p = lspts[tr[k]];
+      xmin = std::min(xmin, p.x());
+      ymin = std::min(ymin, p.y());
+      zmin = std::min(zmin, p.z());
+      xmax = std::max(xmax, p.x());
+      ymax = std::max(ymax, p.y());
+      zmax = std::max(zmax, p.z());
+      std::uint64_t a = std::uint32_t(std::min(tr[k], tr[(k + 1) % 3]));
+      std::uint64_t b = std::uint32_t(std::max(tr[k], tr[(k + 1) % 3]));
+      edges[(a << 32) | b] += 1;
+    }
+    area += std::sqrt(CGAL::squared_area(lspts[tr[0]], lspts[tr[1]], lspts[tr[2]]));
+  }
+  bool closed = true;
+  for (auto& e : edges) {
+    if (e.second != 2) {
+      closed = false;
+      break;
+    }
+  }
+  double dx = xmax - xmin;
+  double dy = ymax - ymin;
+  double dz = zmax - zmin;
+  double bboxarea = 2 * (dx * dy + dx * dz + dy * dz);
+  double ntrs = double(trs.size());
+  double nvol = 4.0 * dx * dy * dz;               //-- 4pts/m^3, upper bound
+  double nsurf = 2.0 * area + 1.5 * ntrs;         //-- 2pts/m^2 + vertices
+  double nwrap = 2.0 * bboxarea / (1.3 * 1.3);    //-- triangles of the alpha-wrap
+  ShellEstimate re;
+  re.cost = ntrs * std::log2(ntrs + 2.0);         //-- repair/orient/mesh
+  re.cost += nvol * std::log2(ntrs + 2.0);        //-- inside tests of the volume sampling
+  re.cost += (nvol / 10.0) * (nvol / 10.0);       //-- cohesion()
+  if (closed == false) {
+    //-- hole filling + alpha-wrap, the latter scales with the surface/alpha^2
+    re.cost += 10.0 * ntrs + 25.0 * nwrap;
+  }
+  //-- the samples are written in place, a Surface_mesh is ~150B/triangle (the
+  //-- original + its copy), its AABB tree ~100B/triangle, the kd-tree
+  //-- ~40B/surface sample, the soup ~60B/triangle. What the pooled workspaces
+  //-- keep between shells is not per shell: the MemoryBudget sets it aside
+  double mem = (nvol + nsurf) * sizeof(PointN);
+  mem += ntrs * (2 * 150 + 100 + 60);
+  mem += nsurf * 40;
+  if (closed == false) {
+    mem += nwrap * (150 + 100) * 4;               //-- wrap mesh + its Delaunay
+  }
+  re.memory = std::size_t(mem);
+  return re;
+}
+
+
+//-- the idle workspaces of the pool hold up to workspace_pool_bytes() whatever
+//-- is admitted: set aside from the limit (at most half of it)
+MemoryBudget::MemoryBudget(std::size_t limit) {
+  _limit = limit - std::min(limit / 2, workspace_pool_bytes());
+  _inuse = 0;
+  _nadmitted = 0;
+  _peak = 0;
+}
+
+//-- blocks until bytes fit in the budget; a shell larger than the whole
+//-- budget is admitted alone (otherwise it would never be)
+void
+MemoryBudget::acquire(std::size_t bytes) {
+  std::unique_lock<std::mutex> lock(_mutex);
+  if (_limit > 0) {
+    _cv.wait(lock, [&]() { return (_nadmitted == 0) || (_inuse + bytes <= _limit); });
+  }
+  _inuse += bytes;
+  _nadmitted += 1;
+  _peak = std::max(_peak, _inuse);
+}
+
+void
+MemoryBudget::release(std::size_t bytes) {
+  std::lock_guard<std::mutex> lock(_mutex);
+  _inuse -= bytes;
+  _nadmitted -= 1;
+  _cv.notify_all();
+}
+
+std::size_t
+MemoryBudget::peak() {
+  std::lock_guard<std::mutex> lock(_mutex);
+  return _peak;
+}
+
+
+MemoryAdmission::MemoryAdmission(MemoryBudget& budget, std::size_t bytes)
+  : _budget(budget), _bytes(bytes) {
+  _budget.acquire(_bytes);
+}
+
+MemoryAdmission::~MemoryAdmission() {
+  _budget.release(_bytes);
+}
+
+
+Scheduler::Scheduler(int nworkers, MemoryBudget* budget) {
+  _nworkers = std::max(1, nworkers);
+  _budget = budget;
+}
+
+int
+Scheduler::nworkers() {
+  return _nworkers;
+}
+
+void
+Scheduler::run(const std::vector<double>& costs, const std::vector<std::size_t>& memory, std::function<void(std::size_t)> task) {
+  if (costs.empty() == true) {
+    return;
+  }
+  //-- longest-processing-time first
+  std::vector<std::size_t> order(costs.size());
+  std::iota(order.begin(), order.end(), 0);
+  std::stable_sort(order.begin(), order.end(),
+                   [&costs](std::size_t a, std::size_t b) { return costs[a] > costs[b]; });
+  //-- the calling thread only waits: its slot in the thread budget goes to the workers
+  int nw = 1 + claim_threads(std::min(_nworkers, int(costs.size())) - 1);
+  if (nw == 1) {
+    for (auto& i : order) {
+      admit_and_run(task, memory, i);
+    }
+    return;
+  }
+  std::vector<WorkQueue> queues(nw);
+  for (std::size_t i = 0; i < order.size(); i++) {
+    queues[i % nw].tasks.push_back(order[i]);
+  }
+  std::exception_ptr eptr = nullptr;
+  std::mutex emutex;
+  std::atomic<int> running(nw);
+  parallel_workers(nw, [&](int w) {
+    std::size_t t;
+    while (pop(queues, w, t) || steal(queues, w, costs, t)) {
+      try {
+        admit_and_run(task, memory, t);
+      } catch (...) {
+        std::lock_guard<std::mutex> lock(emutex);
+        if (eptr == nullptr) {
+          eptr = std::current_exception();
+        }
+      }
+    }
+    //-- idle workers free their slot for the kernels of the shells still running,
+    //-- the last one gives it back to the calling thread
+    if (--running > 0) {
+      return_threads(1);
+    }
+  });
+  if (eptr != nullptr) {
+    std::rethrow_exception(eptr);
+  }
+}
+
+//-- with a budget, the task waits until its memory estimate fits in it
+void
+Scheduler::admit_and_run(std::function<void(std::size_t)>& task, const std::vector<std::size_t>& memory, std::size_t t) {
+  if (_budget == nullptr) {
+    task(t);
+    return;
+  }
+  MemoryAdmission admission(*_budget, memory[t]);
+  task(t);
+}
+
+bool
+Scheduler::pop(std::vector<WorkQueue>& queues, int w, std::size_t& task) {
+  std::lock_guard<std::mutex> lock(queues[w].mutex);
+  if (queues[w].tasks.empty() == true) {
+    return false;
+  }
+  task = queues[w].tasks.front();
+  queues[w].tasks.pop_front();
+  return true;
+}
+
+bool
+Scheduler::steal(std::vector<WorkQueue>& queues, int w, const std::vector<double>& costs, std::size_t& task) {
+  while (true) {
+    //-- victim is the worker with the most expensive pending task
+    int victim = -1;
+    double best = -1.0;
+    for (int v = 0; v < int(queues.size()); v++) {
+      if (v == w) {
+        continue;
+      }
+      std::lock_guard<std::mutex> lock(queues[v].mutex);
+      if ( (queues[v].tasks.empty() == false) && (costs[queues[v].tasks.front()] > best) ) {
+        best = costs[queues[v].tasks.front()];
+        victim = v;
+      }
+    }
+    if (victim == -1) {
+      return false;
+    }
+    std::lock_guard<std::mutex> lock(queues[victim].mutex);
+    if (queues[victim].tasks.empty() == false) {
+      task = queues[victim].tasks.front();
+      queues[victim].tasks.pop_front();
+      return true;
+    }
+    //-- another worker was faster, look again
+  }
+}
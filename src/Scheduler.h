@@ -0,0 +1,81 @@
+#ifndef __Scheduler__
+#define __Scheduler__
+
+#include "definitions.h"
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+
+
+struct ShellEstimate {
+  double        cost;
+  std::size_t   memory;
+};
+
+ShellEstimate   estimate_shell(const std::vector<Triangle>& trs, const std::vector<Point3>& lspts);
+
+
+//-- admission control: the sum of the (estimated) footprints of the shells
+//-- being processed stays under the limit (0 = no limit)
+class MemoryBudget {
+public:
+  MemoryBudget(std::size_t limit);
+
+  void                  acquire(std::size_t bytes);
+  void                  release(std::size_t bytes);
+  std::size_t           peak();
+
+private:
+  std::mutex                    _mutex;
+  std::condition_variable       _cv;
+  std::size_t                   _limit;
+  std::size_t                   _inuse;
+  int                           _nadmitted;
+  std::size_t                   _peak;
+};
+
+
+//-- the memory of one shell admitted in a budget, released when it is
+//-- destroyed (so also when the shell fails or is dropped)
+class MemoryAdmission {
+public:
+  MemoryAdmission(MemoryBudget& budget, std::size_t bytes);
+  ~MemoryAdmission();
+  MemoryAdmission(const MemoryAdmission&) = delete;
+  MemoryAdmission& operator=(const MemoryAdmission&) = delete;
+
+private:
+  MemoryBudget&                 _budget;
+  std::size_t                   _bytes;
+};
+
+
+//-- runs a set of independent tasks on a fixed number of workers.
+//-- tasks are started most-expensive-first (LPT) and dealt round-robin
+//-- to per-worker queues; a worker whose queue is empty steals the most
+//-- expensive pending task of the other workers.
+//-- with a MemoryBudget, a task starts only once its memory is admitted.
+class Scheduler {
+public:
+  Scheduler(int nworkers, MemoryBudget* budget = nullptr);
+
+  int                   nworkers();
+  void                  run(const std::vector<double>& costs, const std::vector<std::size_t>& memory, std::function<void(std::size_t)> task);
+
+private:
+  struct WorkQueue {
+    std::mutex                  mutex;
+    std::deque<std::size_t>     tasks;
+  };
+
+  int                           _nworkers;
+  MemoryBudget*                 _budget;
+
+  void                  admit_and_run(std::function<void(std::size_t)>& task, const std::vector<std::size_t>& memory, std::size_t t);
+  bool                  pop(std::vector<WorkQueue>& queues, int w, std::size_t& task);
+  bool                  steal(std::vector<WorkQueue>& queues, int w, const std::vector<double>& costs, std::size_t& task);
+};
+
+#endif
@@ -1,81 +1,420 @@
 
 #include "Shell.h"
 #include "geomtools.h"
+#include "parallel.h"
+#include "Philox.h"
+#include "SoupInside.h"
+#include "WindingNumber.h"
 
+#include <CGAL/version.h>
 
-Shell::Shell(std::vector<std::vector<int>> trs, std::vector<Point3> lspts) {
-  CGAL::Polygon_mesh_processing::repair_polygon_soup(lspts, trs);
-  CGAL::Polygon_mesh_processing::orient_polygon_soup(lspts, trs);
-  _lspts = lspts;
-  _trs = trs;
-  Mesh mesh;
-  CGAL::Polygon_mesh_processing::polygon_soup_to_polygon_mesh(_lspts, _trs, mesh);   
-  _mesh_original = mesh;
-  if (CGAL::is_closed(_mesh_original) == false) {
-    //-- attempt to fill holes
-    std::vector<halfedge_descriptor> border_cycles;
-    //-- collect one halfedge per boundary cycle
-    CGAL::Polygon_mesh_processing::extract_boundary_cycles(_mesh_original, std::back_inserter(border_cycles));
-    for(halfedge_descriptor h : border_cycles)
-    {
-      std::vector<face_descriptor>  patch_facets;
-      std::vector<vertex_descriptor> patch_vertices;
-      bool success = std::get<0>(
-        CGAL::Polygon_mesh_processing::triangulate_refine_and_fair_hole(_mesh_original,
-                                                                        h,
-                                                                        std::back_inserter(patch_facets),
-                                                                        std::back_inserter(patch_vertices)));
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <numeric>
+
+
+//-- hole filling: limits and the number of holes filled by each tier
+static std::size_t  _hole_max_border = 200;
+static double       _hole_max_seconds = 10.0;
+static double       _hole_max_seconds_each = 2.0;
+static bool         _hole_fair = false;
+static std::atomic<std::size_t> _holes_triangulated(0);
+static std::atomic<std::size_t> _holes_refined(0);
+static std::atomic<std::size_t> _holes_faired(0);
+static std::atomic<std::size_t> _holes_failed(0);
+static std::atomic<std::size_t> _holes_skipped(0);
+
+void set_hole_filling(std::size_t maxborder, double maxseconds, double maxsecondseach, bool fair) {
+  _hole_max_border = maxborder;
+  _hole_max_seconds = maxseconds;
+  _hole_max_seconds_each = maxsecondseach;
+  _hole_fair = fair;
+}
+
+//-- alpha wrap: accuracy (the offset, m), time for a coarse-to-fine wrap
+static double       _wrap_accuracy = 0.3;
+static double       _wrap_max_seconds = 30.0;
+static bool         _wrap_coarse_first = false;
+static bool         _wrap_open = false;
+
+void set_wrap_open_shells(bool wrap) {
+  _wrap_open = wrap;
+}
+
+void set_wrap_parameters(double accuracy, double maxseconds, bool coarsefirst) {
+  _wrap_accuracy = accuracy;
+  _wrap_max_seconds = maxseconds;
+  _wrap_coarse_first = coarsefirst;
+}
+
+//-- volume of the open shells with the winding number: size of the cells (m),
+//-- at most 1/32 of the longest side of the bbox; with more cells than
+//-- WINDING_MAX_CELLS they grow
+static double       _winding_cell = 0.5;
+const std::size_t   WINDING_MAX_CELLS = std::size_t(1) << 24;
+
+void set_winding_cell(double cell) {
+  _winding_cell = cell;
+}
+
+//-- simplification proxy: Hausdorff tolerance (m, 0=none), minimum faces
+static double       _simplify_tolerance = 0.0;
+static std::size_t  _simplify_min_faces = 20000;
+
+void set_simplification(double tolerance, std::size_t minfaces) {
+  _simplify_tolerance = tolerance;
+  _simplify_min_faces = minfaces;
+}
+
+//-- time of the sampling and of the metrics on the samples, all the shells
+static std::atomic<long long> _sampling_ns(0);
+static std::atomic<long long> _sample_metrics_ns(0);
+
+struct ScopedTimer {
+  std::atomic<long long>&                 total;
+  std::chrono::steady_clock::time_point   start;
+  ScopedTimer(std::atomic<long long>& t) : total(t), start(std::chrono::steady_clock::now()) {}
+  ~ScopedTimer() {
+    total += std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+  }
+};
+
+void print_sample_stats(std::ostream& os) {
+  os << "samples in " << KN_NAME << ": sampling " << _sampling_ns / 1e9
+     << "s, metrics on the samples " << _sample_metrics_ns / 1e9 << "s" << std::endl;
+}
+
+void print_hole_stats(std::ostream& os) {
+  os << "holes filled: " << _holes_triangulated << " triangulated, "
+     << _holes_refined << " refined, " << _holes_faired << " refined+faired; "
+     << _holes_failed << " failed, " << _holes_skipped << " skipped (limits)" << std::endl;
+}
+
+
+Shell::Shell()
+  : _ws(acquire_workspace()),
+    _mesh_original(_ws->mesh_original),
+    _mesh_wrap(_ws->mesh_wrap),
+    _mesh_proxy(_ws->mesh_proxy),
+    _samples_surface(_ws->samples_surface),
+    _samples_volume(_ws->samples_volume) {
+}
+
+Shell::~Shell() {
+  if (_ws != nullptr) {
+    release_workspace(std::move(_ws));
+  }
+}
+
+//-- only the points used by the shell are copied (not the whole tile)
+Shell::Shell(const std::vector<Triangle>& trs, const std::vector<Point3>& lspts) : Shell() {
+  std::vector<Triangle> ltrs;
+  std::vector<Point3> lpts;
+  compact_soup(trs, lspts, ltrs, lpts);
+  build(std::move(ltrs), std::move(lpts));
+}
+
+//-- the soup is already local to the shell: it is moved, not copied
+Shell::Shell(std::vector<Triangle>&& trs, std::vector<Point3>&& lspts) : Shell() {
+  build(std::move(trs), std::move(lspts));
+}
+
+void
+Shell::build(std::vector<Triangle>&& trs, std::vector<Point3>&& lspts) {
+  _lspts = std::move(lspts);
+  _trs = std::move(trs);
+  //-- near-duplicate points (within the quantisation) would leave open borders
+  weld_points(_trs, _lspts, get_weld_tolerance(), get_weld_grid());
+  //-- most shells are already closed and consistently oriented: the repair
+  //-- and orientation of the soup are only for those that are not
+  _mesh = &_mesh_original;
+  _mesh_built = false;
+  _proxy = false;
+  _proxy_deviation = 0.0;
+  if (is_closed_oriented_soup(_trs, _lspts) == true) {
+    //-- area and volume directly from the soup, oriented outwards; the
+    //-- samples and the distances also work on the soup, the mesh is only
+    //-- built for the proxy, the wrap or the output
+    SoupMoments m = soup_moments(_trs, _lspts);
+    if (m.volume < 0.0) {
+      for (auto& tr : _trs) {
+        std::swap(tr[1], tr[2]);
+      }
+      m.volume = -m.volume;
     }
+    _area = m.area;
+    _volume = m.volume;
+    return;
+  }
+  CGAL::Polygon_mesh_processing::repair_polygon_soup(_lspts, _trs);
+  CGAL::Polygon_mesh_processing::orient_polygon_soup(_lspts, _trs);
+  build_mesh();
+  if (CGAL::is_closed(_mesh_original) == false) {
+    fill_holes();
   }
   if( (CGAL::is_closed(_mesh_original) == true) && 
       (CGAL::Polygon_mesh_processing::is_outward_oriented(_mesh_original) == false) ) {
     CGAL::Polygon_mesh_processing::reverse_face_orientations(_mesh_original);
   }
-  //-- if still not closed: create the alph-wrap mesh to compute in/out
-  _mesh_wrap = Mesh();
+  //-- if still not closed: in/out with the winding number of the (open) mesh,
+  //-- or (optional) create the alph-wrap mesh to compute in/out (the winding
+  //-- number if the wrap ran out of time)
+  _mesh_wrap.clear();
   if (CGAL::is_closed(_mesh_original) == false) {
-    CGAL::alpha_wrap_3(_mesh_original, 1.3, 0.3, _mesh_wrap); //-- values of Ivan
-    _mesh = &_mesh_wrap;
-    std::cout << "use_wrap_mesh!" << std::endl; // TODO: should we use wrap-alpha if invalid?
-
-  } else {
-    _mesh = &_mesh_original;
+    if ( (_wrap_open == true) && (compute_wrap_mesh() == true) ) {
+      _mesh = &_mesh_wrap;
+      std::cerr << "use_wrap_mesh!" << std::endl; // TODO: should we use wrap-alpha if invalid?
+    } else {
+      std::vector<Point3> pts(_mesh_original.num_vertices(), Point3(0.0, 0.0, 0.0));
+      for (vertex_descriptor v : vertices(_mesh_original)) {
+        pts[v] = _mesh_original.point(v);
+      }
+      std::vector<Triangle> tris;
+      tris.reserve(num_faces(_mesh_original));
+      for (face_descriptor f : faces(_mesh_original)) {
+        Triangle t;
+        int k = 0;
+        for (vertex_descriptor v : CGAL::vertices_around_face(CGAL::halfedge(f, _mesh_original), _mesh_original)) {
+          if (k < 3) {
+            t[k++] = int(v);
+          }
+        }
+        if (k == 3) {
+          tris.push_back(t);
+        }
+      }
+      _winding.reset(new WindingNumber(pts, tris));
+    }
   }
   
   //-- area+volume
   _area = CGAL::Polygon_mesh_processing::area(_mesh_original);
-  _volume = CGAL::Polygon_mesh_processing::volume(*_mesh);
-  //-- samples_surfaces
-  CGAL::Polygon_mesh_processing::sample_triangle_soup(_lspts, 
-                          _trs, 
-                          std::back_inserter(_samples_surface), 
-                          CGAL::parameters::number_of_points_per_area_unit(2).
-                          use_random_uniform_sampling(true)
-  );
+  if (_winding != nullptr) {
+    auto bbox = this->get_aabb();
+    double longest = std::max({bbox.xmax() - bbox.xmin(), bbox.ymax() - bbox.ymin(), bbox.zmax() - bbox.zmin()});
+    _volume = _winding->volume(std::min(_winding_cell, longest / 32.0), WINDING_MAX_CELLS);
+  } else {
+    _volume = CGAL::Polygon_mesh_processing::volume(*_mesh);
+  }
+}
+
+
+//-- the half-edge mesh of the soup, built the first time it is needed
+void
+Shell::build_mesh() {
+  if (_mesh_built == false) {
+    CGAL::Polygon_mesh_processing::polygon_soup_to_polygon_mesh(_lspts, _trs, _mesh_original);
+    _mesh_built = true;
+  }
+}
+
+
+//-- the holes are filled by tiers, from the cheapest:
+//--   1. triangulate_hole() for the small or planar holes;
+//--   2. triangulate_refine_hole();
+//--   3. triangulate_refine_and_fair_hole() (sparse solve) only if allowed;
+//-- a hole that fails goes to the next tier (and the failures of the last
+//-- tiers go back to a plain triangulation). Time limits: one for all the
+//-- holes of the shell, checked before each hole, and one per hole, checked
+//-- between its tiers (a hole over it does not go to the next, slower tier).
+//-- Neither is pre-emptive: one call of CGAL is never interrupted, the
+//-- border limit is what bounds it. The holes with a border longer than the
+//-- limit, or once the time of the shell is spent, are left open:
+//-- the inside of the open shell is then given by the winding number of its
+//-- triangles (or by its alpha wrap with --wrap-open).
+void
+Shell::fill_holes() {
+  namespace PMP = CGAL::Polygon_mesh_processing;
+  const std::size_t smallhole = 8; //-- edges
+  auto start = std::chrono::steady_clock::now();
+  std::vector<halfedge_descriptor> border_cycles;
+  //-- collect one halfedge per boundary cycle
+  PMP::extract_boundary_cycles(_mesh_original, std::back_inserter(border_cycles));
+  for (halfedge_descriptor h : border_cycles) {
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    std::vector<Point3> border;
+    for (halfedge_descriptor hc : CGAL::halfedges_around_face(h, _mesh_original)) {
+      border.push_back(_mesh_original.point(CGAL::target(hc, _mesh_original)));
+    }
+    if ( (border.size() > _hole_max_border) || (elapsed.count() > _hole_max_seconds) ) {
+      _holes_skipped++;
+      continue;
+    }
+    bool planar = false;
+    if (border.size() <= smallhole) {
+      planar = true;
+    } else {
+      std::vector<int> ring(border.size());
+      std::iota(ring.begin(), ring.end(), 0);
+      K::Vector_3 n;
+      double deviation = newell_normal(ring, border, n);
+      double size = std::sqrt(std::sqrt(n.squared_length()) / 2);
+      planar = ( (size > 0.0) && (deviation <= PLANARITY_TOLERANCE * size) );
+    }
+    auto holestart = std::chrono::steady_clock::now();
+    auto overtime = [&]() {
+      std::chrono::duration<double> spent = std::chrono::steady_clock::now() - holestart;
+      return (spent.count() > _hole_max_seconds_each);
+    };
+    std::vector<face_descriptor>  patch_facets;
+    std::vector<vertex_descriptor> patch_vertices;
+    if (planar == true) {
+      PMP::triangulate_hole(_mesh_original, h, std::back_inserter(patch_facets));
+      if (patch_facets.empty() == false) {
+        _holes_triangulated++;
+        continue;
+      }
+      if (overtime() == true) {
+        _holes_skipped++;
+        continue;
+      }
+    }
+    if (_hole_fair == true) {
+      bool success = std::get<0>(PMP::triangulate_refine_and_fair_hole(_mesh_original, h,
+                                                                       std::back_inserter(patch_facets),
+                                                                       std::back_inserter(patch_vertices)));
+      if (success == true) {
+        _holes_faired++;
+        continue;
+      }
+      if ( (patch_facets.empty() == true) && (overtime() == true) ) {
+        _holes_skipped++;
+        continue;
+      }
+    }
+    //-- (the fairing failed: the patch is refined but not faired, it stays)
+    if (patch_facets.empty() == true) {
+      PMP::triangulate_refine_hole(_mesh_original, h,
+                                   std::back_inserter(patch_facets),
+                                   std::back_inserter(patch_vertices));
+    }
+    if (patch_facets.empty() == false) {
+      _holes_refined++;
+    } else if (overtime() == true) {
+      _holes_skipped++;
+    } else if (planar == false) {
+      PMP::triangulate_hole(_mesh_original, h, std::back_inserter(patch_facets));
+      if (patch_facets.empty() == false) {
+        _holes_triangulated++;
+      } else {
+        _holes_failed++;
+      }
+    } else {
+      _holes_failed++;
+    }
+  }
+}
+
+
+void
+Shell::sample(std::uint64_t seed) {
+  ScopedTimer timer(_sampling_ns);
+  //-- all the random numbers come from Philox streams of the seed of the shell:
+  //-- stream (1, b) for the block b of the surface samples, (2, b) for the volume
+  //-- ones. The samples are thus the same for any number of threads.
+
+  //-- samples_surfaces: the vertices + 2pts/m^2 uniformly on the triangles
+  //-- (written in place in the buffer of the workspace, sized beforehand)
+  std::size_t nvertices = _lspts.size();
+  _samples_surface.resize(nvertices);
+  for (std::size_t i = 0; i < nvertices; i++) {
+    _samples_surface[i] = to_numeric(_lspts[i]);
+  }
+  std::vector<double>& cumarea = _ws->cumarea;
+  cumarea.resize(_trs.size());
+  double totalarea = 0.0;
+  for (std::size_t i = 0; i < _trs.size(); i++) {
+    totalarea += std::sqrt(CGAL::squared_area(_lspts[_trs[i][0]], _lspts[_trs[i][1]], _lspts[_trs[i][2]]));
+    cumarea[i] = totalarea;
+  }
+  if (totalarea > 0.0) {
+    std::size_t nsurface = std::max(std::size_t(std::ceil(totalarea * 2.0)), std::size_t(1));
+    std::size_t nsblocks = (nsurface + BLOCK_SIZE - 1) / BLOCK_SIZE;
+    _samples_surface.resize(nvertices + nsurface);
+    parallel_for_blocks(nsblocks, [&](std::size_t b) {
+      Philox rand(seed, (std::uint64_t(1) << 32) | b);
+      std::size_t nb = std::min(nsurface, (b + 1) * BLOCK_SIZE) - (b * BLOCK_SIZE);
+      for (std::size_t k = 0; k < nb; k++) {
+        //-- triangle with probability proportional to its area
+        double t = rand.uniform_real(0.0, totalarea);
+        std::size_t i = std::upper_bound(cumarea.begin(), cumarea.end(), t) - cumarea.begin();
+        i = std::min(i, _trs.size() - 1);
+        double r1 = rand.get_double();
+        double r2 = rand.get_double();
+        if (r1 + r2 > 1.0) {
+          r1 = 1.0 - r1;
+          r2 = 1.0 - r2;
+        }
+        PointN p0 = to_numeric(_lspts[_trs[i][0]]);
+        PointN p1 = to_numeric(_lspts[_trs[i][1]]);
+        PointN p2 = to_numeric(_lspts[_trs[i][2]]);
+        _samples_surface[nvertices + b * BLOCK_SIZE + k] = p0 + (p1 - p0) * r1 + (p2 - p0) * r2;
+      }
+    });
+  }
   // std::cout << "_samples_surface: " << _samples_surface.size() << std::endl;
 
-  //-- samples_volume
+  //-- samples_volume, by blocks of BLOCK_SIZE samples
+  //-- (in/out with the winding number for the open shells only; the closed
+  //-- shells are exact: their mesh or its proxy, or the soup if it has no mesh)
+  build_proxy();
   auto bbox = this->get_aabb();
-  auto rand = CGAL::Random();
-  Mesh* m;
-  if (CGAL::is_closed(_mesh_original) == true) {
-    m = &_mesh_original;
-  } else {
-    m = &_mesh_wrap;
+  std::unique_ptr<SoupInside> soup;
+  std::unique_ptr<AABB_tree> tree;
+  if ( (_winding == nullptr) && (_mesh_built == false) ) {
+    soup.reset(new SoupInside(_lspts, _trs));
+  } else if (_winding == nullptr) {
+    Mesh* m = (_proxy == true) ? &_mesh_proxy : _mesh;
+    tree.reset(new AABB_tree(faces(*m).first, faces(*m).second, *m));
+    tree->build();
   }
-  CGAL::Side_of_triangle_mesh<Mesh, K> inside(*m);
-  int n = 0;
-  int total = int(_volume * 4.0); //-- 4pts/m^3
-  while (n < total) {
-    double x = rand.uniform_real(bbox.xmin(), bbox.xmax());
-    double y = rand.uniform_real(bbox.ymin(), bbox.ymax());
-    double z = rand.uniform_real(bbox.zmin(), bbox.zmax());
-    Point3 p(x, y, z);
-    if (inside(p) == CGAL::ON_BOUNDED_SIDE) { 
-      _samples_volume.push_back(p);
-      n++;
+  std::size_t total = std::size_t(std::max(0, int(_volume * 4.0))); //-- 4pts/m^3
+  std::size_t nblocks = (total + BLOCK_SIZE - 1) / BLOCK_SIZE;
+  _samples_volume.resize(total);
+  std::vector<std::size_t> counts(nblocks, 0);
+  parallel_for_blocks(nblocks, [&](std::size_t b) {
+    Philox rand(seed, (std::uint64_t(2) << 32) | b);
+    std::unique_ptr<Side_of_mesh> inside;
+    if (tree != nullptr) {
+      inside.reset(new Side_of_mesh(*tree));
     }
+    std::size_t nb = std::min(total, (b + 1) * BLOCK_SIZE) - (b * BLOCK_SIZE);
+    std::size_t n = 0;
+    //-- bounded, in case a broken shell has (almost) no inside
+    std::size_t maxtries = 1000 * nb;
+    for (std::size_t tries = 0; (n < nb) && (tries < maxtries); tries++) {
+      double x = rand.uniform_real(bbox.xmin(), bbox.xmax());
+      double y = rand.uniform_real(bbox.ymin(), bbox.ymax());
+      double z = rand.uniform_real(bbox.zmin(), bbox.zmax());
+      PointN p(x, y, z);
+      bool in;
+      if (inside != nullptr) {
+        in = ((*inside)(to_robust(p)) == CGAL::ON_BOUNDED_SIDE);
+      } else if (soup != nullptr) {
+        in = soup->is_inside(to_robust(p));
+      } else {
+        in = _winding->is_inside(p);
+      }
+      if (in == true) { 
+        _samples_volume[b * BLOCK_SIZE + n] = p;
+        n++;
+      }
+    }
+    counts[b] = n;
+  });
+  //-- blocks that gave up early leave gaps: compact, in block order
+  std::size_t nvolume = 0;
+  for (std::size_t b = 0; b < nblocks; b++) {
+    if (nvolume != b * BLOCK_SIZE) {
+      std::move(_samples_volume.begin() + b * BLOCK_SIZE,
+                _samples_volume.begin() + b * BLOCK_SIZE + counts[b],
+                _samples_volume.begin() + nvolume);
+    }
+    nvolume += counts[b];
   }
+  _samples_volume.resize(nvolume);
   // std::cout << "_samples_volume.size() " << _samples_volume.size() << std::endl;
   // for (auto& p : _samples_volume)
     // std::cout << p << std::endl;
@@ -84,34 +423,183 @@ Shell::Shell(std::vector<std::vector<int>> trs, std::vector<Point3> lspts) {
 
 
 
-//-- returns the radius
-double Shell::largest_sphere_inside_mesh() {
-  // https://github.com/CGAL/cgal/blob/master/Polygon_mesh_processing/test/Polygon_mesh_processing/test_pmp_distance.cpp
-  double re = CGAL::Polygon_mesh_processing::max_distance_to_triangle_mesh<CGAL::Parallel_if_available_tag>(
-    _samples_volume, 
-    _mesh_original);
-  return re;
+//-- proxy of a very detailed closed mesh for the volume queries (in/out of the
+//-- volume samples, distance to the surface): edge collapses that keep each
+//-- new vertex within the tolerance of the mesh. The area and the surface
+//-- samples keep the original. The deviation reported is the relative
+//-- change of the volume.
+void
+Shell::build_proxy() {
+  namespace SMS = CGAL::Surface_mesh_simplification;
+  if ( (_proxy == true) || (_simplify_tolerance <= 0.0) || (_winding != nullptr) ) {
+    return;
+  }
+  std::size_t nfaces = (_mesh_built == true) ? num_faces(*_mesh) : _trs.size();
+  if (nfaces < _simplify_min_faces) {
+    return;
+  }
+  build_mesh();
+  if (CGAL::is_closed(*_mesh) == false) {
+    return;
+  }
+  _mesh_proxy = *_mesh;
+  SMS::Edge_count_ratio_stop_predicate<Mesh> stop(0.01);
+  SMS::Bounded_distance_placement<SMS::LindstromTurk_placement<Mesh>> placement(_simplify_tolerance);
+  SMS::edge_collapse(_mesh_proxy, stop, CGAL::parameters::get_placement(placement));
+  _mesh_proxy.collect_garbage();
+  double v = CGAL::Polygon_mesh_processing::volume(_mesh_proxy);
+  _proxy_deviation = (_volume > 0.0) ? (std::abs(v - _volume) / _volume) : 0.0;
+  _proxy = true;
+}
 
+bool
+Shell::is_simplified() {
+  return _proxy;
 }
 
+double
+Shell::simplification_deviation() {
+  return _proxy_deviation;
+}
 
-void
+
+//-- returns the radius: the largest distance of a volume sample to the
+//-- surface (the mesh or its proxy if there is one, otherwise the soup)
+double Shell::largest_sphere_inside_mesh() {
+  if ( (_proxy == true) || (_mesh_built == true) ) {
+    // https://github.com/CGAL/cgal/blob/master/Polygon_mesh_processing/test/Polygon_mesh_processing/test_pmp_distance.cpp
+    std::vector<Point3> samples;
+    samples.reserve(_samples_volume.size());
+    for (auto& p : _samples_volume) {
+      samples.push_back(to_robust(p));
+    }
+    double re = 0.0;
+    parallel_isolated([&]() {
+      re = CGAL::Polygon_mesh_processing::max_distance_to_triangle_mesh<CONCURRENCY_TAG>(
+        samples, 
+        (_proxy == true) ? _mesh_proxy : _mesh_original);
+    });
+    return re;
+  }
+  std::vector<KN::Triangle_3> triangles;
+  triangles.reserve(_trs.size());
+  for (auto& tr : _trs) {
+    triangles.push_back(KN::Triangle_3(to_numeric(_lspts[tr[0]]), to_numeric(_lspts[tr[1]]), to_numeric(_lspts[tr[2]])));
+  }
+  Soup_tree tree(triangles.begin(), triangles.end());
+  tree.accelerate_distance_queries();
+  tree.build(); //-- not lazily, it is shared by the threads
+  //-- the max of each block, then of the blocks (the same for any threads)
+  std::size_t n = _samples_volume.size();
+  std::size_t nblocks = (n + BLOCK_SIZE - 1) / BLOCK_SIZE;
+  std::vector<double> partial(nblocks, 0.0);
+  parallel_for_blocks(nblocks, [&](std::size_t b) {
+    std::size_t end = std::min(n, (b + 1) * BLOCK_SIZE);
+    double d = 0.0;
+    for (std::size_t i = b * BLOCK_SIZE; i < end; i++) {
+      d = std::max(d, tree.squared_distance(_samples_volume[i]));
+    }
+    partial[b] = d;
+  });
+  double re = 0.0;
+  for (auto& d : partial) {
+    re = std::max(re, d);
+  }
+  return std::sqrt(re);
+}
+
+
+#if CGAL_VERSION_NR >= CGAL_VERSION_NUMBER(6, 0, 0)
+//-- stops a wrap once the deadline is passed (go_further(), CGAL 6): the
+//-- wrap is then not refined to alpha and offset everywhere
+struct WrapDeadline : public CGAL::Alpha_wraps_3::internal::Wrapping_default_visitor {
+  std::chrono::steady_clock::time_point   deadline;
+  bool*                                   interrupted;
+  template <typename Wrapper>
+  bool go_further(const Wrapper&) {
+    if (std::chrono::steady_clock::now() > deadline) {
+      *interrupted = true;
+      return false;
+    }
+    return true;
+  }
+};
+#endif
+
+//-- one alpha wrap, stopped at the deadline; false if it was interrupted
+//-- (before CGAL 6 a wrap cannot be interrupted, it always completes)
+static bool alpha_wrap_until(const Mesh& in, double alpha, double offset, Mesh& out,
+                             std::chrono::steady_clock::time_point deadline) {
+#if CGAL_VERSION_NR >= CGAL_VERSION_NUMBER(6, 0, 0)
+  bool interrupted = false;
+  WrapDeadline visitor;
+  visitor.deadline = deadline;
+  visitor.interrupted = &interrupted;
+  CGAL::alpha_wrap_3(in, alpha, offset, out, CGAL::parameters::visitor(visitor));
+  return (interrupted == false);
+#else
+  (void)deadline;
+  CGAL::alpha_wrap_3(in, alpha, offset, out);
+  return true;
+#endif
+}
+
+
+//-- the offset of the wrap is the accuracy asked, and alpha grows with the size
+//-- of the shell so that the cost is bounded (about WRAP_RELATIVE_ALPHA alphas
+//-- along the diagonal of the bbox at most); small shells keep the values of
+//-- Ivan (1.3, 0.3). Coarse-to-fine: the first wrap is 4x coarser, then alpha
+//-- and offset are halved until the volume changes less than 1% or the target
+//-- is reached. The time of the shell bounds every wrap (one wrap or all the
+//-- coarse-to-fine ones): a wrap interrupted at the deadline is replaced by
+//-- the previous complete one, or kept if it is closed. false if there is no
+//-- usable wrap (then the winding number is used).
+//-- (before CGAL 6 a wrap cannot be interrupted: the time is only checked
+//-- between the coarse-to-fine wraps)
+bool
 Shell::compute_wrap_mesh() {
-  // const double relative_alpha = 300.0;
-  // const double relative_offset = 1200.0;
-  // auto bbox = this->get_aabb();
-  // const double diag_length = std::sqrt(CGAL::square(bbox.xmax() - bbox.xmin()) +
-  //                                      CGAL::square(bbox.ymax() - bbox.ymin()) +
-  //                                      CGAL::square(bbox.zmax() - bbox.zmin()));
-  // const double alpha = diag_length / relative_alpha;
-  // const double offset = diag_length / relative_offset;
-  // CGAL::alpha_wrap_3(_mesh_original, alpha, offset, _mesh_wrap);
-  CGAL::alpha_wrap_3(_mesh_original, 1.3, 0.3, _mesh_wrap); //-- values of Ivan
+  build_mesh();
+  const double WRAP_RELATIVE_ALPHA = 100.0;
+  const double WRAP_VOLUME_TOLERANCE = 0.01;
+  auto bbox = this->get_aabb();
+  const double diag_length = std::sqrt(CGAL::square(bbox.xmax() - bbox.xmin()) +
+                                       CGAL::square(bbox.ymax() - bbox.ymin()) +
+                                       CGAL::square(bbox.zmax() - bbox.zmin()));
+  const double offset = _wrap_accuracy;
+  const double alpha = std::max(offset * 1.3 / 0.3, diag_length / WRAP_RELATIVE_ALPHA);
+  _mesh_wrap.clear();
+  auto start = std::chrono::steady_clock::now();
+  auto deadline = start + std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                            std::chrono::duration<double>(_wrap_max_seconds));
+  bool usable = false;
+  double previous = -1.0;
+  for (double scale = (_wrap_coarse_first == true) ? 4.0 : 1.0; scale >= 1.0; scale /= 2) {
+    Mesh wrap;
+    if (alpha_wrap_until(_mesh_original, alpha * scale, offset * scale, wrap, deadline) == false) {
+      if ( (usable == false) && (num_faces(wrap) > 0) && (CGAL::is_closed(wrap) == true) ) {
+        _mesh_wrap = std::move(wrap);
+        usable = true;
+      }
+      break;
+    }
+    double vol = CGAL::Polygon_mesh_processing::volume(wrap);
+    _mesh_wrap = std::move(wrap);
+    usable = true;
+    if ( (previous > 0.0) && (std::abs(vol - previous) <= WRAP_VOLUME_TOLERANCE * vol) ) {
+      break;
+    }
+    if (std::chrono::steady_clock::now() > deadline) {
+      break;
+    }
+    previous = vol;
+  }
+  return usable;
 }
 
 
 void 
 Shell::use_wrap_mesh(bool b) {
+  build_mesh();
   if (b == true) { 
     _mesh = &_mesh_wrap;
   } else {
@@ -129,7 +617,8 @@ Shell::get_convex_hull() {
 std::array<Point3,8> 
 Shell::get_oobb() {
   std::array<Point3, 8> obb_points;
-  CGAL::oriented_bounding_box(_lspts, obb_points);
+  //-- fixed seed: the optimisation is randomised
+  CGAL::oriented_bounding_box(_lspts, obb_points, CGAL::parameters::random_seed(0));
   return obb_points;
 }
 
@@ -140,11 +629,13 @@ Shell::get_aabb() {
 
 Mesh* 
 Shell::get_mesh() {
+  build_mesh();
   return _mesh;
 }
 
 bool 
 Shell::is_closed() {
+  build_mesh();
   return CGAL::is_closed(*_mesh);
 }
 
@@ -158,9 +649,14 @@ Shell::area() {
   return _area;
 }
 
-Point3
+PointN
 Shell::centroid() {
-  return CGAL::centroid(_samples_surface.begin(), _samples_surface.end());
+  //-- of the surface samples, with the same reproducible sums as the metrics
+  std::size_t n = _samples_surface.size();
+  double x = parallel_sum(n, [&](std::size_t i) { return _samples_surface[i].x(); });
+  double y = parallel_sum(n, [&](std::size_t i) { return _samples_surface[i].y(); });
+  double z = parallel_sum(n, [&](std::size_t i) { return _samples_surface[i].z(); });
+  return PointN(x / n, y / n, z / n);
 }
 
 double
@@ -171,12 +667,16 @@ Shell::circumference() {
 
 double
 Shell::cohesion() {
-  double totaldistance = 0.0;
-  for (auto i = 0; i < _samples_volume.size(); i+=10) {
-    for (auto j = 0; j < _samples_volume.size(); j+=10) {
-      totaldistance += sqrt(CGAL::squared_distance(_samples_volume[i], _samples_volume[j]));
+  ScopedTimer timer(_sample_metrics_ns);
+  std::size_t n = _samples_volume.size();
+  //-- one row (i) of the every-10th-sample distance matrix per item
+  double totaldistance = parallel_sum((n + 9) / 10, [&](std::size_t i) {
+    double d = 0.0;
+    for (std::size_t j = 0; j < n; j += 10) {
+      d += sqrt(CGAL::squared_distance(_samples_volume[i * 10], _samples_volume[j]));
     }
-  }
+    return d;
+  }, 16);
   double re = 36 / 35 * pow(3 * _volume / (4 * 3.14159), 1.0/3.0) / (1 / pow(_samples_volume.size()/10.0, 2.0) * totaldistance);
   return re;
 }
@@ -184,7 +684,9 @@ Shell::cohesion() {
 
 double
 Shell::convexity() {
-  Polyhedron p = this->get_convex_hull();
+  Polyhedron& p = _ws->hull;
+  p.clear();
+  CGAL::convex_hull_3(_lspts.begin(), _lspts.end(), p);
   double vol = CGAL::Polygon_mesh_processing::volume(p);
   return (_volume / vol);
 }
@@ -204,12 +706,14 @@ Shell::cuboidindex() {
 
 double
 Shell::depth() {
+  ScopedTimer timer(_sample_metrics_ns);
   return (4 * this->avg_dist_samples_volume_surface() / pow(3 * _volume / 4 / 3.14159, 1.0/3.0));
 }
 
 
 double
 Shell::dispersion() {
+  ScopedTimer timer(_sample_metrics_ns);
   double re = 1 - (this->avg_dist_samples_surface_radius_sphere() / this->avg_dist_samples_surface_centroid());
   return re;
 }
@@ -223,6 +727,7 @@ Shell::fractality() {
 
 double
 Shell::girth() {
+  ScopedTimer timer(_sample_metrics_ns);
   double re = this->largest_sphere_inside_mesh() / pow(3 * _volume / 4 / 3.14159, 1.0/3.0);
   return re;
 }
@@ -235,6 +740,7 @@ Shell::hemisphericality() {
 
 double
 Shell::proximity() {
+  ScopedTimer timer(_sample_metrics_ns);
   double re = 0.75 * pow(3 * _volume / 4 / 3.14159, 1.0/3.0) / this->avg_dist_samples_volume_centroid();
   return re;
 }
@@ -256,63 +762,57 @@ Shell::rectangularity() {
 
 double
 Shell::roughness() {
+  ScopedTimer timer(_sample_metrics_ns);
   return (pow(this->avg_dist_samples_surface_centroid(), 3.0) * 48.735 / (_volume + pow(_area, 1.5)));
 }
 
 double
 Shell::spin() {
+  ScopedTimer timer(_sample_metrics_ns);
   double re = 0.6 * pow(3 * _volume / 4 / 3.14159, 2.0/3.0) / this->avg_sq_dist_samples_volume_centroid();
   return re;
 }
 
 double
 Shell::avg_dist_samples_surface_radius_sphere() {
-  Point3 c = CGAL::centroid(_samples_surface.begin(), _samples_surface.end());
+  PointN c = this->centroid();
   double r = get_sphere_radius_from_volume(_volume);
-  double distance = 0.0;
-  int total = 0;   
-  for (auto& s : _samples_surface) {
-    total += 1;
-    distance += abs(sqrt(CGAL::squared_distance(c, s)) - r);
-  }
-  return (distance / total);
+  double distance = parallel_sum(_samples_surface.size(), [&](std::size_t i) {
+    return std::abs(sqrt(CGAL::squared_distance(c, _samples_surface[i])) - r);
+  });
+  return (distance / _samples_surface.size());
 }
 
 
 double
 Shell::avg_dist_samples_surface_centroid() {
-  Point3 c = CGAL::centroid(_samples_surface.begin(), _samples_surface.end());
-  double distance = 0.0;
-  int total = 0;     
-  for (auto& s : _samples_surface) {
-    total += 1;
-    distance += sqrt(CGAL::squared_distance(c, s));
-  }
-  return (distance / total);
+  PointN c = this->centroid();
+  double distance = parallel_sum(_samples_surface.size(), [&](std::size_t i) {
+    return sqrt(CGAL::squared_distance(c, _samples_surface[i]));
+  });
+  return (distance / _samples_surface.size());
 }
 
 double
 Shell::avg_dist_samples_volume_centroid() {
-  Point3 c = CGAL::centroid(_samples_surface.begin(), _samples_surface.end());
-  double distance = 0.0;
-  int total = 0;     
-  for (auto& s : _samples_volume) {
-    total += 1;
-    distance += sqrt(CGAL::squared_distance(c, s));
-  }
-  return (distance / total);
+  PointN c = this->centroid();
+  double distance = parallel_sum(_samples_volume.size(), [&](std::size_t i) {
+    return sqrt(CGAL::squared_distance(c, _samples_volume[i]));
+  });
+  return (distance / _samples_volume.size());
 }
 
 double
 Shell::avg_dist_samples_volume_surface() {
-  double distance = 0.0;
-  int count = 0;
-  KDTree kdtree(_samples_surface.begin(), _samples_surface.end());
-  for (auto i = 0; i < _samples_volume.size(); i+=10) {
-    Neighbor_search search(kdtree, _samples_volume[i], 1);
-    distance += std::sqrt(search.begin()->second);
-    count++;
-  }
+  KDTree& kdtree = _ws->kdtree;
+  kdtree.clear();
+  kdtree.insert(_samples_surface.begin(), _samples_surface.end());
+  kdtree.build(); //-- not lazily, it is shared by the threads
+  std::size_t count = (_samples_volume.size() + 9) / 10;
+  double distance = parallel_sum(count, [&](std::size_t i) {
+    Neighbor_search search(kdtree, _samples_volume[i * 10], 1);
+    return std::sqrt(search.begin()->second);
+  });
   return (distance / count);
 }
 
@@ -323,7 +823,7 @@ Shell::avg_dist_samples_volume_surface() {
 //   for (auto i = 0; i < _samples_volume.size(); i+=10) {
 //     std::vector<Point3> v;
 //     v.push_back(_samples_volume[i]);
-//     double d = CGAL::Polygon_mesh_processing::max_distance_to_triangle_mesh<CGAL::Parallel_if_available_tag>(
+//     double d = CGAL::Polygon_mesh_processing::max_distance_to_triangle_mesh<CONCURRENCY_TAG>(
 //                 v, 
 //                 _mesh_original);
 //     distance += d;
@@ -334,17 +834,15 @@ Shell::avg_dist_samples_volume_surface() {
 
 double
 Shell::avg_sq_dist_samples_volume_centroid() {
-  Point3 c = CGAL::centroid(_samples_surface.begin(), _samples_surface.end());
-  double distance = 0.0;
-  int total = 0;     
-  for (auto& s : _samples_volume) {
-    total += 1;
-    distance += CGAL::squared_distance(c, s);
-  }
-  return (distance / total);
+  PointN c = this->centroid();
+  double distance = parallel_sum(_samples_volume.size(), [&](std::size_t i) {
+    return CGAL::squared_distance(c, _samples_volume[i]);
+  });
+  return (distance / _samples_volume.size());
 }
 
 void
 Shell::write_off(std::string s) {
+  build_mesh();
    CGAL::IO::write_polygon_mesh(s, *_mesh, CGAL::parameters::stream_precision(17));
 }
\ No newline at end of file
@@ -1,12 +1,24 @@
 
 
 #include "definitions.h"
+#include "WindingNumber.h"
+#include "Workspace.h"
+
+#include <cstdint>
+#include <memory>
+#include <ostream>
 
 class Shell {
 public:
-  Shell(std::vector<std::vector<int>> trs, std::vector<Point3> lspts);
+  //-- trs index the points of the tile (lspts), or only those of the shell
+  //-- when they are moved in
+  Shell(const std::vector<Triangle>& trs, const std::vector<Point3>& lspts);
+  Shell(std::vector<Triangle>&& trs, std::vector<Point3>&& lspts);
+  ~Shell();
+
+  void                  sample(std::uint64_t seed);
 
-  void                  compute_wrap_mesh();
+  bool                  compute_wrap_mesh();
   void                  use_wrap_mesh(bool b);
 
   Mesh*                 get_mesh();
@@ -15,6 +27,10 @@ public:
   K::Iso_cuboid_3       get_aabb();
   
   bool                  is_closed();
+  //-- the volume queries use a simplified proxy of the mesh; relative
+  //-- deviation of its volume
+  bool                  is_simplified();
+  double                simplification_deviation();
 
   double                area();
   double                circumference();
@@ -40,22 +56,55 @@ public:
 
 private:
   std::vector<Point3>           _lspts;
-  std::vector<std::vector<int>> _trs;
+  std::vector<Triangle>         _trs;
   
-  Mesh                          _mesh_original;
-  Mesh                          _mesh_wrap;
+  //-- the meshes and samples are in the workspace (reused across shells)
+  std::unique_ptr<ShellWorkspace> _ws;
+  Mesh&                         _mesh_original;
+  Mesh&                         _mesh_wrap;
+  Mesh&                         _mesh_proxy;
+  bool                          _proxy;
+  double                        _proxy_deviation;
   Mesh*                         _mesh;
+  bool                          _mesh_built;
+  std::unique_ptr<WindingNumber> _winding;  //-- in/out of an open shell (not wrapped)
 
   double                        _area;
   double                        _volume;
-  std::vector<Point3>           _samples_surface;
-  std::vector<Point3>           _samples_volume;
+  std::vector<PointN>&          _samples_surface;
+  std::vector<PointN>&          _samples_volume;
 
+  Shell();
+  void                  build(std::vector<Triangle>&& trs, std::vector<Point3>&& lspts);
+  void                  build_mesh();
+  void                  build_proxy();
+  void                  fill_holes();
   double                avg_dist_samples_surface_centroid();
   double                avg_dist_samples_volume_centroid();
   double                avg_dist_samples_volume_surface();
   double                avg_sq_dist_samples_volume_centroid();
-  Point3                centroid();
+  PointN                centroid();
   double                largest_sphere_inside_mesh();
   double                avg_dist_samples_surface_radius_sphere();
-};
\ No newline at end of file
+};
+
+//-- limits of the hole filling: border (in edges), time for all the holes of
+//-- a shell and time of one hole (between its tiers, not pre-emptive);
+//-- fair=true allows the refine+fair tier
+void    set_hole_filling(std::size_t maxborder, double maxseconds, double maxsecondseach, bool fair);
+void    print_hole_stats(std::ostream& os);
+//-- alpha wrap of the open shells: accuracy (m), time for the coarse-to-fine
+//-- wrap of a shell, coarsefirst=true starts coarse and refines if needed
+void    set_wrap_parameters(double accuracy, double maxseconds, bool coarsefirst);
+//-- wrap=true: the open shells are alpha-wrapped, otherwise their inside is
+//-- given by the generalised winding number of their triangles
+void    set_wrap_open_shells(bool wrap);
+//-- size of the cells (m) counted for the volume of the open shells that use
+//-- the winding number (the error is at most about their area times it)
+void    set_winding_cell(double cell);
+//-- shells with more than minfaces faces use a proxy simplified within
+//-- tolerance (m) for the volume queries; tolerance=0: no simplification
+void    set_simplification(double tolerance, std::size_t minfaces);
+//-- time spent in the sampling and in the metrics on the samples (summed over
+//-- the shells and the threads), and the kernel of the samples
+void    print_sample_stats(std::ostream& os);
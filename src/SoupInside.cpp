@@ -0,0 +1,99 @@
+#include "SoupInside.h"
+
+#include <cmath>
+
+
+//-- directions tried before giving up (a point is then outside), and the
+//-- results of crossings() that are not counts
+const int     MAX_RAYS = 32;
+const int     DEGENERATE = -1;
+const int     ON_SURFACE = -2;
+const double  TWO_PI = 2.0 * 3.14159265358979323846;
+
+
+SoupInside::SoupInside(const std::vector<Point3>& lspts, const std::vector<Triangle>& trs) {
+  _triangles.reserve(trs.size());
+  for (auto& tr : trs) {
+    const Point3& a = lspts[tr[0]];
+    const Point3& b = lspts[tr[1]];
+    const Point3& c = lspts[tr[2]];
+    //-- no area: never crossed properly, its neighbours decide
+    if (CGAL::collinear(a, b, c) == false) {
+      _triangles.push_back(K::Triangle_3(a, b, c));
+    }
+  }
+  _bbox = CGAL::bounding_box(lspts.begin(), lspts.end());
+  _reach = 2.0 * std::sqrt(CGAL::square(_bbox.xmax() - _bbox.xmin()) +
+                           CGAL::square(_bbox.ymax() - _bbox.ymin()) +
+                           CGAL::square(_bbox.zmax() - _bbox.zmin())) + 1.0;
+  _tree.insert(_triangles.begin(), _triangles.end());
+  _tree.build();
+}
+
+bool
+SoupInside::is_inside(const Point3& p) const {
+  if ( (_triangles.empty() == true) || (_bbox.has_on_unbounded_side(p) == true) ) {
+    return false;
+  }
+  //-- the directions are a fixed spiral, so the result does not depend on
+  //-- the thread or on the order of the queries
+  for (int k = 0; k < MAX_RAYS; k++) {
+    double z = 1.0 - 2.0 * std::fmod(0.3 + k * 0.618033988749895, 1.0);
+    double t = TWO_PI * std::fmod(0.1 + k * 0.754877666248967, 1.0);
+    double s = std::sqrt(std::max(0.0, 1.0 - z * z));
+    Point3 q(p.x() + _reach * s * std::cos(t), p.y() + _reach * s * std::sin(t), p.z() + _reach * z);
+    int n = crossings(p, q);
+    if (n == ON_SURFACE) {
+      return false;
+    }
+    if (n != DEGENERATE) {
+      return (n % 2) == 1;
+    }
+  }
+  return false;
+}
+
+int
+SoupInside::crossings(const Point3& p, const Point3& q) const {
+  //-- q is beyond the bbox: the segment crosses what the ray from p would
+  std::vector<Soup_robust_tree::Primitive_id> hits;
+  _tree.all_intersected_primitives(K::Segment_3(p, q), std::back_inserter(hits));
+  int n = 0;
+  for (auto& id : hits) {
+    const Point3& a = id->vertex(0);
+    const Point3& b = id->vertex(1);
+    const Point3& c = id->vertex(2);
+    CGAL::Orientation op = CGAL::orientation(a, b, c, p);
+    if (op == CGAL::COPLANAR) {
+      return (id->has_on(p) == true) ? ON_SURFACE : DEGENERATE;
+    }
+    CGAL::Orientation oq = CGAL::orientation(a, b, c, q);
+    if (oq == CGAL::COPLANAR) {
+      return DEGENERATE;
+    }
+    if (op == oq) {
+      continue;
+    }
+    //-- the line pq against the 3 edges: all on the same side is a proper
+    //-- crossing, a zero with the others on one side an edge or a vertex
+    CGAL::Orientation s[3] = {CGAL::orientation(p, q, a, b),
+                              CGAL::orientation(p, q, b, c),
+                              CGAL::orientation(p, q, c, a)};
+    bool pos = false;
+    bool neg = false;
+    bool zero = false;
+    for (int i = 0; i < 3; i++) {
+      pos = pos || (s[i] == CGAL::POSITIVE);
+      neg = neg || (s[i] == CGAL::NEGATIVE);
+      zero = zero || (s[i] == CGAL::ZERO);
+    }
+    if ( (pos == true) && (neg == true) ) {
+      continue;
+    }
+    if (zero == true) {
+      return DEGENERATE;
+    }
+    n += 1;
+  }
+  return n;
+}
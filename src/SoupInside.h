@@ -0,0 +1,31 @@
+#ifndef __SoupInside__
+#define __SoupInside__
+
+#include "definitions.h"
+
+
+//-- exact in/out of a closed soup, without its mesh: parity of the triangles
+//-- crossed by a segment from the point to beyond the bbox, all with the
+//-- predicates of K (as Side_of_triangle_mesh on the mesh). A segment
+//-- through an edge or a vertex, or starting in the plane of a triangle, is
+//-- degenerate and another direction is tried. A point on the surface is
+//-- not inside. The queries are thread-safe.
+class SoupInside {
+public:
+  SoupInside(const std::vector<Point3>& lspts, const std::vector<Triangle>& trs);
+  SoupInside(const SoupInside&) = delete;
+  SoupInside& operator=(const SoupInside&) = delete;
+
+  bool                  is_inside(const Point3& p) const;
+
+private:
+  std::vector<K::Triangle_3>  _triangles;
+  Soup_robust_tree            _tree;
+  K::Iso_cuboid_3             _bbox;
+  double                      _reach;   //-- longer than the diagonal of the bbox
+
+  //-- crossings of the segment pq, or DEGENERATE / ON_SURFACE
+  int                   crossings(const Point3& p, const Point3& q) const;
+};
+
+#endif
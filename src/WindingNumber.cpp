@@ -0,0 +1,210 @@
+#include "WindingNumber.h"
+#include "parallel.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+
+//-- triangles per leaf, and distance (in radii of a node) beyond which the
+//-- dipole of the node is used
+const int     LEAF_SIZE = 8;
+const double  BETA = 2.0;
+const double  FOUR_PI = 4.0 * 3.14159265358979323846;
+
+
+WindingNumber::WindingNumber(const std::vector<Point3>& lspts, const std::vector<Triangle>& trs) {
+  int n = int(trs.size());
+  //-- the unsorted triangles and the centroids are only for the construction
+  ArenaScope scope;
+  ArenaVector<double> tris(9 * std::size_t(n));
+  ArenaVector<double> centroids(3 * std::size_t(n));
+  double inf = std::numeric_limits<double>::max();
+  for (int k = 0; k < 3; k++) {
+    _bbox[k] = inf;
+    _bbox[k + 3] = -inf;
+  }
+  for (int i = 0; i < n; i++) {
+    for (int v = 0; v < 3; v++) {
+      const Point3& p = lspts[trs[i][v]];
+      double c[3] = {p.x(), p.y(), p.z()};
+      for (int k = 0; k < 3; k++) {
+        tris[9 * i + 3 * v + k] = c[k];
+        centroids[3 * i + k] += c[k] / 3.0;
+        _bbox[k] = std::min(_bbox[k], c[k]);
+        _bbox[k + 3] = std::max(_bbox[k + 3], c[k]);
+      }
+    }
+  }
+  ArenaVector<int> order(n);
+  for (int i = 0; i < n; i++) {
+    order[i] = i;
+  }
+  _nodes.reserve(2 * (n / LEAF_SIZE + 1));
+  if (n > 0) {
+    build(order, centroids, tris, 0, n);
+  }
+  //-- the triangles in the order of the leaves
+  _tris.resize(tris.size());
+  for (int i = 0; i < n; i++) {
+    std::copy(tris.begin() + 9 * order[i], tris.begin() + 9 * order[i] + 9, _tris.begin() + 9 * i);
+  }
+}
+
+int
+WindingNumber::build(ArenaVector<int>& order, ArenaVector<double>& centroids,
+                     const ArenaVector<double>& tris, int begin, int end) {
+  int id = int(_nodes.size());
+  _nodes.push_back(Node());
+  //-- dipole: area-weighted normals and centre
+  double normal[3] = {0.0, 0.0, 0.0};
+  double centre[3] = {0.0, 0.0, 0.0};
+  double mean[3] = {0.0, 0.0, 0.0};
+  double area = 0.0;
+  double cmin[3] = {std::numeric_limits<double>::max(), std::numeric_limits<double>::max(), std::numeric_limits<double>::max()};
+  double cmax[3] = {-cmin[0], -cmin[1], -cmin[2]};
+  for (int i = begin; i < end; i++) {
+    const double* t = &tris[9 * order[i]];
+    double u[3] = {t[3] - t[0], t[4] - t[1], t[5] - t[2]};
+    double v[3] = {t[6] - t[0], t[7] - t[1], t[8] - t[2]};
+    double a[3] = {0.5 * (u[1] * v[2] - u[2] * v[1]),
+                   0.5 * (u[2] * v[0] - u[0] * v[2]),
+                   0.5 * (u[0] * v[1] - u[1] * v[0])};
+    double ai = std::sqrt(a[0] * a[0] + a[1] * a[1] + a[2] * a[2]);
+    const double* c = &centroids[3 * order[i]];
+    for (int k = 0; k < 3; k++) {
+      normal[k] += a[k];
+      centre[k] += ai * c[k];
+      mean[k] += c[k];
+      cmin[k] = std::min(cmin[k], c[k]);
+      cmax[k] = std::max(cmax[k], c[k]);
+    }
+    area += ai;
+  }
+  for (int k = 0; k < 3; k++) {
+    centre[k] = (area > 0.0) ? (centre[k] / area) : (mean[k] / (end - begin));
+  }
+  double radius = 0.0;
+  for (int i = begin; i < end; i++) {
+    const double* t = &tris[9 * order[i]];
+    for (int v = 0; v < 3; v++) {
+      double dx = t[3 * v] - centre[0];
+      double dy = t[3 * v + 1] - centre[1];
+      double dz = t[3 * v + 2] - centre[2];
+      radius = std::max(radius, dx * dx + dy * dy + dz * dz);
+    }
+  }
+  int left = -1;
+  int right = -1;
+  if (end - begin > LEAF_SIZE) {
+    //-- median split along the longest axis of the centroids
+    int axis = 0;
+    for (int k = 1; k < 3; k++) {
+      if (cmax[k] - cmin[k] > cmax[axis] - cmin[axis]) {
+        axis = k;
+      }
+    }
+    int mid = begin + (end - begin) / 2;
+    std::nth_element(order.begin() + begin, order.begin() + mid, order.begin() + end,
+                     [&centroids, axis](int a, int b) { return centroids[3 * a + axis] < centroids[3 * b + axis]; });
+    left = build(order, centroids, tris, begin, mid);
+    right = build(order, centroids, tris, mid, end);
+  }
+  Node& node = _nodes[id];
+  for (int k = 0; k < 3; k++) {
+    node.centre[k] = centre[k];
+    node.normal[k] = normal[k];
+  }
+  node.radius = std::sqrt(radius);
+  node.begin = begin;
+  node.end = end;
+  node.left = left;
+  node.right = right;
+  return id;
+}
+
+double
+WindingNumber::winding_number(const PointN& q) const {
+  if (_nodes.empty() == true) {
+    return 0.0;
+  }
+  double qx = q.x();
+  double qy = q.y();
+  double qz = q.z();
+  double w = 0.0;
+  int stack[128];
+  int top = 0;
+  stack[top++] = 0;
+  while (top > 0) {
+    const Node& node = _nodes[stack[--top]];
+    double dx = node.centre[0] - qx;
+    double dy = node.centre[1] - qy;
+    double dz = node.centre[2] - qz;
+    double d2 = dx * dx + dy * dy + dz * dz;
+    if (d2 > BETA * BETA * node.radius * node.radius) {
+      //-- far: the dipole of the node
+      double d = std::sqrt(d2);
+      w += (dx * node.normal[0] + dy * node.normal[1] + dz * node.normal[2]) / (d2 * d);
+    } else if (node.left == -1) {
+      //-- near leaf: exact solid angles (Van Oosterom and Strackee)
+      for (int i = node.begin; i < node.end; i++) {
+        const double* t = &_tris[9 * std::size_t(i)];
+        double a[3] = {t[0] - qx, t[1] - qy, t[2] - qz};
+        double b[3] = {t[3] - qx, t[4] - qy, t[5] - qz};
+        double c[3] = {t[6] - qx, t[7] - qy, t[8] - qz};
+        double la = std::sqrt(a[0] * a[0] + a[1] * a[1] + a[2] * a[2]);
+        double lb = std::sqrt(b[0] * b[0] + b[1] * b[1] + b[2] * b[2]);
+        double lc = std::sqrt(c[0] * c[0] + c[1] * c[1] + c[2] * c[2]);
+        double det = a[0] * (b[1] * c[2] - b[2] * c[1])
+                   - a[1] * (b[0] * c[2] - b[2] * c[0])
+                   + a[2] * (b[0] * c[1] - b[1] * c[0]);
+        double ab = a[0] * b[0] + a[1] * b[1] + a[2] * b[2];
+        double ac = a[0] * c[0] + a[1] * c[1] + a[2] * c[2];
+        double bc = b[0] * c[0] + b[1] * c[1] + b[2] * c[2];
+        double denom = la * lb * lc + ab * lc + ac * lb + bc * la;
+        w += 2.0 * std::atan2(det, denom);
+      }
+    } else {
+      stack[top++] = node.left;
+      stack[top++] = node.right;
+    }
+  }
+  return w / FOUR_PI;
+}
+
+bool
+WindingNumber::is_inside(const PointN& q) const {
+  return winding_number(q) > 0.5;
+}
+
+double
+WindingNumber::volume(double cell, std::size_t maxcells) const {
+  if ( (_nodes.empty() == true) || (cell <= 0.0) ) {
+    return 0.0;
+  }
+  std::size_t n[3];
+  std::size_t ncells;
+  while (true) {
+    ncells = 1;
+    for (int k = 0; k < 3; k++) {
+      n[k] = std::max(std::size_t(1), std::size_t(std::ceil((_bbox[k + 3] - _bbox[k]) / cell)));
+      ncells *= n[k];
+    }
+    if (ncells <= maxcells) {
+      break;
+    }
+    cell *= std::max(std::cbrt(double(ncells) / maxcells), 1.01);
+  }
+  //-- the cells fill the bbox exactly, so they are at most cell on each axis
+  double sx = (_bbox[3] - _bbox[0]) / n[0];
+  double sy = (_bbox[4] - _bbox[1]) / n[1];
+  double sz = (_bbox[5] - _bbox[2]) / n[2];
+  double inside = parallel_sum(ncells, [&](std::size_t i) {
+    std::size_t ix = i % n[0];
+    std::size_t iy = (i / n[0]) % n[1];
+    std::size_t iz = i / (n[0] * n[1]);
+    PointN p(_bbox[0] + (ix + 0.5) * sx, _bbox[1] + (iy + 0.5) * sy, _bbox[2] + (iz + 0.5) * sz);
+    return is_inside(p) ? 1.0 : 0.0;
+  });
+  return inside * sx * sy * sz;
+}
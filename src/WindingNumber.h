@@ -0,0 +1,45 @@
+#ifndef __WindingNumber__
+#define __WindingNumber__
+
+#include "definitions.h"
+#include "Arena.h"
+
+
+//-- generalised winding number of a triangle soup (Barill et al., "Fast
+//-- winding numbers for soups and clouds", SIGGRAPH 2018): ~1 inside and ~0
+//-- outside, also for open or slightly broken soups, so they need no wrap.
+//-- the triangles are in a binary tree; far from a node (BETA times its
+//-- radius) its triangles are approximated by one dipole: the sum of their
+//-- area-weighted normals at their area-weighted centre.
+class WindingNumber {
+public:
+  WindingNumber(const std::vector<Point3>& lspts, const std::vector<Triangle>& trs);
+
+  double                winding_number(const PointN& q) const;
+  bool                  is_inside(const PointN& q) const;
+  //-- volume of the inside, counted at the centres of cubic cells of at most
+  //-- cell (m) over the bbox; the cells grow if more than maxcells are needed.
+  //-- only the cells cut by the surface can be wrong: the error is at most
+  //-- about the area times the cell, much less in practice (they cancel out)
+  double                volume(double cell, std::size_t maxcells) const;
+
+private:
+  struct Node {
+    double              centre[3];
+    double              normal[3];
+    double              radius;
+    int                 begin;    //-- triangles [begin, end) of _tris
+    int                 end;
+    int                 left;     //-- -1 for a leaf
+    int                 right;
+  };
+
+  std::vector<double>   _tris;    //-- 9 coordinates per triangle, in tree order
+  std::vector<Node>     _nodes;
+  double                _bbox[6];
+
+  int                   build(ArenaVector<int>& order, ArenaVector<double>& centroids,
+                              const ArenaVector<double>& tris, int begin, int end);
+};
+
+#endif
@@ -0,0 +1,295 @@
+#include "WorkerPool.h"
+#include "parallel.h"
+#include "geomtools.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <csignal>
+#include <cstring>
+#include <iostream>
+#include <numeric>
+#include <stdexcept>
+
+#include <poll.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+
+static std::size_t align8(std::size_t n) {
+  return (n + 7) & ~std::size_t(7);
+}
+
+
+WorkerPool::WorkerPool(int nworkers, std::size_t memorylimit, Compute compute) {
+  _nworkers = std::max(1, nworkers);
+  _memorylimit = memorylimit;
+  _compute = compute;
+  _slotsize = 0;
+  _slots = nullptr;
+  //-- writing to a worker that just died must not kill us
+  std::signal(SIGPIPE, SIG_IGN);
+}
+
+WorkerPool::~WorkerPool() {
+  for (auto& worker : _workers) {
+    stop(worker);
+  }
+  if (_slots != nullptr) {
+    munmap(_slots, _slotsize * _nworkers);
+  }
+}
+
+//-- the points of the shell are compacted (only those used, renumbered);
+//-- with slot == nullptr only the size is returned
+std::size_t
+WorkerPool::serialise(char* slot, const std::string& id, std::uint64_t seed,
+                      const std::vector<Triangle>& trs, const std::vector<Point3>& lspts) {
+  std::vector<Triangle> ltrs;
+  std::vector<Point3> lpts;
+  compact_soup(trs, lspts, ltrs, lpts);
+  std::size_t size = align8(sizeof(SlotHeader)) + align8(id.size())
+                   + lpts.size() * 3 * sizeof(double) + ltrs.size() * 3 * sizeof(std::int32_t);
+  if (slot == nullptr) {
+    return size;
+  }
+  SlotHeader* h = reinterpret_cast<SlotHeader*>(slot);
+  h->seed = seed;
+  h->idlen = std::uint32_t(id.size());
+  h->npts = std::uint32_t(lpts.size());
+  h->ntrs = std::uint32_t(ltrs.size());
+  h->status = 0;
+  h->resultlen = 0;
+  char* p = slot + align8(sizeof(SlotHeader));
+  std::memcpy(p, id.data(), id.size());
+  double* pts = reinterpret_cast<double*>(p + align8(id.size()));
+  for (std::size_t i = 0; i < lpts.size(); i++) {
+    pts[3 * i] = lpts[i].x();
+    pts[3 * i + 1] = lpts[i].y();
+    pts[3 * i + 2] = lpts[i].z();
+  }
+  std::int32_t* tris = reinterpret_cast<std::int32_t*>(pts + 3 * lpts.size());
+  for (std::size_t i = 0; i < ltrs.size(); i++) {
+    for (int k = 0; k < 3; k++) {
+      tris[3 * i + k] = std::int32_t(ltrs[i][k]);
+    }
+  }
+  return size;
+}
+
+void
+WorkerPool::spawn(int w) {
+  Worker& worker = _workers[w];
+  int tojob[2];
+  int toresult[2];
+  if ( (pipe(tojob) != 0) || (pipe(toresult) != 0) ) {
+    throw std::runtime_error(std::string("WorkerPool: pipe failed: ") + std::strerror(errno));
+  }
+  std::cout.flush();
+  std::cerr.flush();
+  pid_t pid = fork();
+  if (pid < 0) {
+    throw std::runtime_error(std::string("WorkerPool: fork failed: ") + std::strerror(errno));
+  }
+  if (pid == 0) {
+    //-- the worker: only keep its own 2 pipe ends, otherwise the parent would
+    //-- not see the EOF when another worker dies
+    for (int i = 0; i < int(_workers.size()); i++) {
+      if ( (i != w) && (_workers[i].pid > 0) ) {
+        close(_workers[i].jobfd);
+        close(_workers[i].resultfd);
+      }
+    }
+    close(tojob[1]);
+    close(toresult[0]);
+    worker.jobfd = tojob[0];
+    worker.resultfd = toresult[1];
+    work(worker);
+    _exit(0);
+  }
+  close(tojob[0]);
+  close(toresult[1]);
+  worker.pid = pid;
+  worker.jobfd = tojob[1];
+  worker.resultfd = toresult[0];
+  worker.busy = false;
+}
+
+//-- loop of the worker process (never returns to the caller's code)
+void
+WorkerPool::work(Worker& worker) {
+  //-- one process = one core; this is a fresh process for TBB too
+  set_nthreads(1);
+  char c;
+  while (read(worker.jobfd, &c, 1) == 1) {
+    SlotHeader* h = reinterpret_cast<SlotHeader*>(worker.slot);
+    char* p = worker.slot + align8(sizeof(SlotHeader));
+    std::string id(p, h->idlen);
+    const double* pts = reinterpret_cast<const double*>(p + align8(h->idlen));
+    const std::int32_t* tris = reinterpret_cast<const std::int32_t*>(pts + 3 * h->npts);
+    std::vector<Point3> lspts;
+    lspts.reserve(h->npts);
+    for (std::uint32_t i = 0; i < h->npts; i++) {
+      lspts.push_back(Point3(pts[3 * i], pts[3 * i + 1], pts[3 * i + 2]));
+    }
+    std::vector<Triangle> trs(h->ntrs);
+    for (std::uint32_t i = 0; i < h->ntrs; i++) {
+      trs[i] = {tris[3 * i], tris[3 * i + 1], tris[3 * i + 2]};
+    }
+    std::string result;
+    double deviation = -1.0;
+    try {
+      result = _compute(id, h->seed, trs, lspts, deviation);
+      h->status = 0;
+    } catch (std::exception& e) {
+      result = e.what();
+      h->status = 1;
+    } catch (...) {
+      result = "unknown exception";
+      h->status = 1;
+    }
+    //-- the shell is not needed anymore, the result overwrites it
+    std::size_t room = _slotsize - align8(sizeof(SlotHeader));
+    h->resultlen = std::uint32_t(std::min(result.size(), room));
+    h->deviation = deviation;
+    std::memcpy(p, result.data(), h->resultlen);
+    if (write(worker.resultfd, "d", 1) != 1) {
+      break;
+    }
+  }
+}
+
+void
+WorkerPool::stop(Worker& worker) {
+  if (worker.pid > 0) {
+    close(worker.jobfd);
+    close(worker.resultfd);
+    int status;
+    waitpid(worker.pid, &status, 0);
+    worker.pid = -1;
+  }
+}
+
+void
+WorkerPool::run(const std::vector<std::string>& ids,
+                const std::vector<std::uint64_t>& seeds,
+                const std::vector<std::vector<Triangle>>& shells,
+                const std::vector<Point3>& lspts,
+                const std::vector<double>& costs,
+                const std::vector<std::size_t>& memory,
+                std::vector<std::string>& rows,
+                std::vector<double>& deviations,
+                std::vector<std::string>& failures) {
+  rows.assign(shells.size(), std::string());
+  deviations.assign(shells.size(), -1.0);
+  if (shells.empty() == true) {
+    return;
+  }
+  //-- one slot per worker, large enough for the largest shell (and a row)
+  _slotsize = 64 * 1024;
+  for (std::size_t i = 0; i < shells.size(); i++) {
+    _slotsize = std::max(_slotsize, serialise(nullptr, ids[i], seeds[i], shells[i], lspts));
+  }
+  _slotsize = align8(_slotsize);
+  void* m = mmap(nullptr, _slotsize * _nworkers, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+  if (m == MAP_FAILED) {
+    throw std::runtime_error(std::string("WorkerPool: mmap failed: ") + std::strerror(errno));
+  }
+  _slots = static_cast<char*>(m);
+  _workers.resize(_nworkers);
+  for (int w = 0; w < _nworkers; w++) {
+    _workers[w].pid = -1;
+    _workers[w].slot = _slots + w * _slotsize;
+  }
+  for (int w = 0; w < _nworkers; w++) {
+    spawn(w);
+  }
+  //-- most expensive first
+  std::vector<std::size_t> order(shells.size());
+  std::iota(order.begin(), order.end(), 0);
+  std::stable_sort(order.begin(), order.end(),
+                   [&costs](std::size_t a, std::size_t b) { return costs[a] > costs[b]; });
+  std::size_t next = 0;
+  std::size_t inflight = 0;
+  std::size_t inflightmemory = 0;
+  while ( (next < order.size()) || (inflight > 0) ) {
+    //-- dispatch to the idle workers (while the memory fits)
+    for (auto& worker : _workers) {
+      if ( (worker.busy == true) || (next == order.size()) ) {
+        continue;
+      }
+      std::size_t job = order[next];
+      if ( (_memorylimit > 0) && (inflight > 0) && (inflightmemory + memory[job] > _memorylimit) ) {
+        break;
+      }
+      serialise(worker.slot, ids[job], seeds[job], shells[job], lspts);
+      worker.busy = true;
+      worker.job = job;
+      inflight += 1;
+      inflightmemory += memory[job];
+      next += 1;
+      if (write(worker.jobfd, "j", 1) != 1) {
+        //-- dead already: the EOF on its result pipe handles it
+      }
+    }
+    //-- wait for results (or deaths)
+    std::vector<pollfd> fds;
+    std::vector<int> fdworker;
+    for (int w = 0; w < _nworkers; w++) {
+      if (_workers[w].busy == true) {
+        pollfd pfd;
+        pfd.fd = _workers[w].resultfd;
+        pfd.events = POLLIN;
+        pfd.revents = 0;
+        fds.push_back(pfd);
+        fdworker.push_back(w);
+      }
+    }
+    if (poll(fds.data(), fds.size(), -1) < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      throw std::runtime_error(std::string("WorkerPool: poll failed: ") + std::strerror(errno));
+    }
+    for (std::size_t i = 0; i < fds.size(); i++) {
+      if (fds[i].revents == 0) {
+        continue;
+      }
+      Worker& worker = _workers[fdworker[i]];
+      std::size_t job = worker.job;
+      char c;
+      ssize_t r = read(worker.resultfd, &c, 1);
+      if (r == 1) {
+        SlotHeader* h = reinterpret_cast<SlotHeader*>(worker.slot);
+        std::string result(worker.slot + align8(sizeof(SlotHeader)), h->resultlen);
+        if (h->status == 0) {
+          rows[job] = result;
+          deviations[job] = h->deviation;
+        } else {
+          failures.push_back(ids[job] + ": " + result);
+        }
+        worker.busy = false;
+      } else {
+        //-- the worker died with the shell
+        int status = 0;
+        waitpid(worker.pid, &status, 0);
+        std::string reason = "worker died";
+        if (WIFSIGNALED(status)) {
+          reason = std::string("crashed (") + strsignal(WTERMSIG(status)) + ")";
+        } else if (WIFEXITED(status)) {
+          reason = "worker exited with code " + std::to_string(WEXITSTATUS(status));
+        }
+        failures.push_back(ids[job] + ": " + reason);
+        close(worker.jobfd);
+        close(worker.resultfd);
+        worker.pid = -1;
+        spawn(fdworker[i]);
+      }
+      inflight -= 1;
+      inflightmemory -= memory[job];
+    }
+  }
+  for (auto& worker : _workers) {
+    stop(worker);
+  }
+}
@@ -0,0 +1,74 @@
+#ifndef __WorkerPool__
+#define __WorkerPool__
+
+#include "definitions.h"
+
+#include <cstdint>
+#include <functional>
+#include <sys/types.h>
+
+
+//-- pool of forked worker processes (POSIX only), so that a shell crashing
+//-- (segfault, abort in CGAL, ...) does not kill the whole run. Each worker
+//-- has a slot of shared memory in which it receives its shell (compacted
+//-- points + triangles) and returns the CSV row (and the volume deviation of
+//-- the simplified proxy, negative if there is none). A worker that dies is
+//-- recorded as failed for its shell, respawned, and the run continues.
+class WorkerPool {
+public:
+  typedef std::function<std::string(const std::string& id,
+                                    std::uint64_t seed,
+                                    std::vector<Triangle>& trs,
+                                    std::vector<Point3>& lspts,
+                                    double& deviation)>             Compute;
+
+  WorkerPool(int nworkers, std::size_t memorylimit, Compute compute);
+  ~WorkerPool();
+
+  //-- rows[i] is the row of shell i, empty if it failed (then in failures),
+  //-- and deviations[i] the deviation of its proxy
+  void                  run(const std::vector<std::string>& ids,
+                            const std::vector<std::uint64_t>& seeds,
+                            const std::vector<std::vector<Triangle>>& shells,
+                            const std::vector<Point3>& lspts,
+                            const std::vector<double>& costs,
+                            const std::vector<std::size_t>& memory,
+                            std::vector<std::string>& rows,
+                            std::vector<double>& deviations,
+                            std::vector<std::string>& failures);
+
+private:
+  struct SlotHeader {
+    std::uint64_t       seed;
+    std::uint32_t       idlen;
+    std::uint32_t       npts;
+    std::uint32_t       ntrs;
+    std::int32_t        status;     //-- 0: ok, 1: exception (result is its message)
+    std::uint32_t       resultlen;
+    double              deviation;
+  };
+
+  struct Worker {
+    pid_t               pid;
+    int                 jobfd;      //-- parent -> worker: a job is in the slot
+    int                 resultfd;   //-- worker -> parent: the result is in the slot
+    char*               slot;
+    bool                busy;
+    std::size_t         job;
+  };
+
+  int                           _nworkers;
+  std::size_t                   _memorylimit;
+  Compute                       _compute;
+  std::vector<Worker>           _workers;
+  std::size_t                   _slotsize;
+  char*                         _slots;
+
+  void                  spawn(int w);
+  void                  work(Worker& worker);
+  void                  stop(Worker& worker);
+  std::size_t           serialise(char* slot, const std::string& id, std::uint64_t seed,
+                                  const std::vector<Triangle>& trs, const std::vector<Point3>& lspts);
+};
+
+#endif
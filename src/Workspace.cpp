@@ -0,0 +1,62 @@
+#include "Workspace.h"
+#include "parallel.h"
+
+#include <algorithm>
+#include <mutex>
+
+
+//-- a workspace that grew larger than this is given back to the allocator
+//-- instead of the pool, so that one huge shell does not keep its memory for
+//-- the run
+const std::size_t WORKSPACE_MAX_BYTES = std::size_t(32) << 20;
+
+static std::mutex                                   _pool_mutex;
+static std::vector<std::unique_ptr<ShellWorkspace>> _pool;
+
+
+void ShellWorkspace::clear() {
+  mesh_original.clear();
+  mesh_wrap.clear();
+  mesh_proxy.clear();
+  samples_surface.clear();
+  samples_volume.clear();
+  cumarea.clear();
+  kdtree.clear();
+  hull.clear();
+}
+
+//-- a Surface_mesh is ~150B/face, the kd-tree ~40B/point (as estimate_shell())
+std::size_t ShellWorkspace::bytes() const {
+  std::size_t b = (samples_surface.capacity() + samples_volume.capacity()) * sizeof(PointN);
+  b += cumarea.capacity() * sizeof(double);
+  b += (mesh_original.number_of_faces() + mesh_wrap.number_of_faces() + mesh_proxy.number_of_faces()) * 150;
+  b += kdtree.size() * 40;
+  return b;
+}
+
+std::unique_ptr<ShellWorkspace> acquire_workspace() {
+  {
+    std::lock_guard<std::mutex> lock(_pool_mutex);
+    if (_pool.empty() == false) {
+      std::unique_ptr<ShellWorkspace> ws = std::move(_pool.back());
+      _pool.pop_back();
+      return ws;
+    }
+  }
+  return std::unique_ptr<ShellWorkspace>(new ShellWorkspace());
+}
+
+void release_workspace(std::unique_ptr<ShellWorkspace> ws) {
+  if (ws->bytes() > WORKSPACE_MAX_BYTES) {
+    return;
+  }
+  ws->clear();
+  std::lock_guard<std::mutex> lock(_pool_mutex);
+  if (_pool.size() < std::size_t(std::max(1, get_nthreads()))) {
+    _pool.push_back(std::move(ws));
+  }
+}
+
+std::size_t workspace_pool_bytes() {
+  return std::size_t(std::max(1, get_nthreads())) * WORKSPACE_MAX_BYTES;
+}
@@ -0,0 +1,35 @@
+#ifndef __Workspace__
+#define __Workspace__
+
+#include "definitions.h"
+
+#include <memory>
+
+
+//-- the meshes and buffers of a Shell, cleared but kept from shell to shell so
+//-- that their capacity is reused. Each Shell takes one from a pool and gives
+//-- it back when it is destroyed; the pool keeps at most one per thread, and
+//-- only the small ones, so what the idle workspaces hold is bounded by
+//-- workspace_pool_bytes(). Not thread_local: in the pipeline a Shell moves
+//-- from the threads of one stage to those of the next.
+struct ShellWorkspace {
+  Mesh                  mesh_original;
+  Mesh                  mesh_wrap;
+  Mesh                  mesh_proxy;
+  std::vector<PointN>   samples_surface;
+  std::vector<PointN>   samples_volume;
+  std::vector<double>   cumarea;
+  KDTree                kdtree;
+  Polyhedron            hull;
+
+  void                  clear();
+  //-- rough size of what it holds (bytes)
+  std::size_t           bytes() const;
+};
+
+std::unique_ptr<ShellWorkspace> acquire_workspace();
+void                            release_workspace(std::unique_ptr<ShellWorkspace> ws);
+//-- upper bound of the memory held by the idle workspaces of the pool
+std::size_t                     workspace_pool_bytes();
+
+#endif
@@ -3,6 +3,7 @@
 
 // CGAL kernel
 #include <CGAL/Exact_predicates_inexact_constructions_kernel.h>
+#include <CGAL/Simple_cartesian.h>
 #include <CGAL/Random.h>
 #include <CGAL/optimal_bounding_box.h>
 #include <CGAL/Polyhedron_3.h>
@@ -12,6 +13,10 @@
 #include <CGAL/convex_hull_3.h>
 #include <CGAL/squared_distance_3.h> 
 #include <CGAL/Side_of_triangle_mesh.h>
+#include <CGAL/AABB_tree.h>
+#include <CGAL/AABB_traits.h>
+#include <CGAL/AABB_face_graph_triangle_primitive.h>
+#include <CGAL/AABB_triangle_primitive.h>
 
 #include <CGAL/Constrained_Delaunay_triangulation_2.h>
 #include <CGAL/linear_least_squares_fitting_3.h>
@@ -29,6 +34,11 @@
 #include <CGAL/Polygon_mesh_processing/triangulate_hole.h>
 #include <CGAL/Polygon_mesh_processing/border.h>
 
+#include <CGAL/Surface_mesh_simplification/edge_collapse.h>
+#include <CGAL/Surface_mesh_simplification/Policies/Edge_collapse/Edge_count_ratio_stop_predicate.h>
+#include <CGAL/Surface_mesh_simplification/Policies/Edge_collapse/LindstromTurk_placement.h>
+#include <CGAL/Surface_mesh_simplification/Policies/Edge_collapse/Bounded_distance_placement.h>
+
 #include <CGAL/boost/graph/helpers.h>
 #include <CGAL/boost/graph/property_maps.h>
 
@@ -38,6 +48,8 @@
 #include <CGAL/Orthogonal_k_neighbor_search.h>
 #include <CGAL/Search_traits_3.h>
 
+#include <array>
+
 //-- for mark_domain()
 struct FaceInfo2
 {
@@ -48,9 +60,10 @@ struct FaceInfo2
   }
 };  
 
-// //-- use for the Concurrency_tag of 
-// //-- https://doc.cgal.org/latest/Polygon_mesh_processing/group__PMP__distance__grp.html#gaed9454c6ed046cd4fb7928cf2b5f7c2c
-// #define CONCURRENCY_TAG CGAL::Parallel_if_available_tag
+//-- use for the Concurrency_tag of all the PMP functions that have one, eg
+//-- https://doc.cgal.org/latest/Polygon_mesh_processing/group__PMP__distance__grp.html#gaed9454c6ed046cd4fb7928cf2b5f7c2c
+//-- (parallel only if linked with TBB, and then bounded by --threads)
+#define CONCURRENCY_TAG CGAL::Parallel_if_available_tag
 
 typedef CGAL::Exact_predicates_inexact_constructions_kernel K;
 
@@ -62,6 +75,29 @@ typedef CGAL::Polygon_2<K>          Polygon2;
 typedef K::Plane_3                  Plane;
 typedef CGAL::Surface_mesh<Point3>  Mesh;
 
+//-- kernel of the numeric work on the samples (generation, distances, sums,
+//-- kd-tree): there robust predicates are never needed. Orientation, in/out
+//-- tests, triangulations and meshes stay in K. BUMO_EPICK_SAMPLES uses K
+//-- for the samples too, to compare (the timings are printed with --verbose)
+#ifdef BUMO_EPICK_SAMPLES
+typedef K                           KN;
+const char* const KN_NAME = "EPICK";
+#else
+typedef CGAL::Simple_cartesian<double> KN;
+const char* const KN_NAME = "Simple_cartesian<double>";
+#endif
+typedef KN::Point_3                 PointN;
+
+inline PointN to_numeric(const Point3& p) {
+  return PointN(p.x(), p.y(), p.z());
+}
+inline Point3 to_robust(const PointN& p) {
+  return Point3(p.x(), p.y(), p.z());
+}
+//-- a triangle of a soup: 3 indices in the points, a flat std::array (no
+//-- allocation per triangle), accepted as polygon by the PMP soup functions
+typedef std::array<int, 3>          Triangle;
+
 // CGAL typedefs
 typedef CGAL::Triangulation_vertex_base_with_id_2 <K>             Vb;
 typedef CGAL::Triangulation_face_base_with_info_2<FaceInfo2, K>   Fbb;
@@ -69,15 +105,35 @@ typedef CGAL::Constrained_triangulation_face_base_2<K, Fbb>       Fb;
 typedef CGAL::Triangulation_data_structure_2<Vb,Fb>               TDS;
 typedef CGAL::Exact_intersections_tag                             Itag;
 typedef CGAL::Constrained_Delaunay_triangulation_2<K, TDS, Itag>  CT;
+//-- without constructions for the intersections of constraints (throws
+//-- Intersection_of_constraints_exception, then CT is used)
+typedef CGAL::No_constraint_intersection_requiring_constructions_tag  ItagFast;
+typedef CGAL::Constrained_Delaunay_triangulation_2<K, TDS, ItagFast>  CTFast;
 
 typedef boost::graph_traits<Mesh>::vertex_descriptor        vertex_descriptor;
 typedef boost::graph_traits<Mesh>::halfedge_descriptor      halfedge_descriptor;
 typedef boost::graph_traits<Mesh>::face_descriptor          face_descriptor;
 
+//-- one AABB tree shared by several in/out testers (one per thread)
+typedef CGAL::AABB_face_graph_triangle_primitive<Mesh>      AABB_primitive;
+typedef CGAL::AABB_traits<K, AABB_primitive>                AABB_traits;
+typedef CGAL::AABB_tree<AABB_traits>                        AABB_tree;
+typedef CGAL::Side_of_triangle_mesh<Mesh, K, CGAL::Default, AABB_tree>  Side_of_mesh;
+//-- AABB tree of the triangles of a soup (distances to the samples, no mesh)
+typedef std::vector<KN::Triangle_3>::const_iterator         Soup_iterator;
+typedef CGAL::AABB_triangle_primitive<KN, Soup_iterator>    Soup_primitive;
+typedef CGAL::AABB_traits<KN, Soup_primitive>               Soup_traits;
+typedef CGAL::AABB_tree<Soup_traits>                        Soup_tree;
+//-- the same in K, for the exact in/out of a closed soup (SoupInside)
+typedef std::vector<K::Triangle_3>::const_iterator          Soup_robust_iterator;
+typedef CGAL::AABB_triangle_primitive<K, Soup_robust_iterator> Soup_robust_primitive;
+typedef CGAL::AABB_traits<K, Soup_robust_primitive>         Soup_robust_traits;
+typedef CGAL::AABB_tree<Soup_robust_traits>                 Soup_robust_tree;
+
 typedef CGAL::Min_sphere_of_points_d_traits_3<K,double>     MSPT;
 typedef CGAL::Min_sphere_of_spheres_d<MSPT>                 Min_sphere;
 
-typedef CGAL::Search_traits_3<K>                            KDTreeTraits;
+typedef CGAL::Search_traits_3<KN>                           KDTreeTraits;
 typedef CGAL::Orthogonal_k_neighbor_search<KDTreeTraits>    Neighbor_search;
 typedef Neighbor_search::Tree                               KDTree;
 
@@ -1,5 +1,11 @@
 
 #include "geomtools.h"
+#include "Arena.h"
+
+#include <cmath>
+#include <cstdint>
+#include <unordered_map>
+#include <unordered_set>
 
 
 double get_sphere_radius_from_volume(double vol) {
@@ -7,7 +13,7 @@ double get_sphere_radius_from_volume(double vol) {
 }
 
 
-double mu(std::vector<Point3>& shellpts, std::vector<std::vector<int>>& trs, const std::vector<Point3>& lspts) {
+double mu(std::vector<Point3>& shellpts, std::vector<Triangle>& trs, const std::vector<Point3>& lspts) {
   std::vector<Point3> samples;
   //-- for better sampling not affected by small triangles somewhere
   CGAL::Polygon_mesh_processing::sample_triangle_soup(lspts, 
@@ -29,7 +35,40 @@ double mu(std::vector<Point3>& shellpts, std::vector<std::vector<int>>& trs, con
 }
 
 
-double area_shell(std::vector<std::vector<int>>& trs, const std::vector<Point3>& lspts) {
+//-- one pass over the triangles: each one with a reference point (the first
+//-- vertex, for the precision far from the origin) is a tetrahedron
+SoupMoments soup_moments(const std::vector<Triangle>& trs, const std::vector<Point3>& lspts) {
+  SoupMoments m;
+  m.area = 0.0;
+  m.volume = 0.0;
+  if (trs.empty() == true) {
+    return m;
+  }
+  const Point3& r = lspts[trs[0][0]];
+  double area = 0.0;
+  double vol6 = 0.0;
+  for (auto& tr : trs) {
+    double a[3] = {lspts[tr[0]].x() - r.x(), lspts[tr[0]].y() - r.y(), lspts[tr[0]].z() - r.z()};
+    double b[3] = {lspts[tr[1]].x() - r.x(), lspts[tr[1]].y() - r.y(), lspts[tr[1]].z() - r.z()};
+    double d[3] = {lspts[tr[2]].x() - r.x(), lspts[tr[2]].y() - r.y(), lspts[tr[2]].z() - r.z()};
+    //-- area from the cross product of 2 edges
+    double u[3] = {b[0] - a[0], b[1] - a[1], b[2] - a[2]};
+    double v[3] = {d[0] - a[0], d[1] - a[1], d[2] - a[2]};
+    double nx = u[1] * v[2] - u[2] * v[1];
+    double ny = u[2] * v[0] - u[0] * v[2];
+    double nz = u[0] * v[1] - u[1] * v[0];
+    area += 0.5 * std::sqrt(nx * nx + ny * ny + nz * nz);
+    //-- 6x the signed volume of the tetrahedron (r, a, b, d)
+    vol6 += a[0] * (b[1] * d[2] - b[2] * d[1])
+          - a[1] * (b[0] * d[2] - b[2] * d[0])
+          + a[2] * (b[0] * d[1] - b[1] * d[0]);
+  }
+  m.area = area;
+  m.volume = vol6 / 6.0;
+  return m;
+}
+
+double area_shell(std::vector<Triangle>& trs, const std::vector<Point3>& lspts) {
   double total = 0.0;
   for (auto& tr : trs) {
     total += std::sqrt(CGAL::squared_area(lspts[tr[0]], lspts[tr[1]], lspts[tr[2]]));
@@ -37,7 +76,7 @@ double area_shell(std::vector<std::vector<int>>& trs, const std::vector<Point3>&
   return std::abs(total);
 }
 
-double volume_shell(std::vector<std::vector<int>>& trs, const std::vector<Point3>& lspts) {
+double volume_shell(std::vector<Triangle>& trs, const std::vector<Point3>& lspts) {
   double total = 0.0;
   Point3 p0(0.0, 0.0, 0.0);
   for (auto& tr : trs) {
@@ -48,6 +87,180 @@ double volume_shell(std::vector<std::vector<int>>& trs, const std::vector<Point3
   return abs(total);
 }
 
+//-- the soup with only the points it uses (renumbered in order of use): the
+//-- work is in the size of the shell, not of the tile
+void compact_soup(const std::vector<Triangle>& trs, const std::vector<Point3>& lspts,
+                  std::vector<Triangle>& ltrs, std::vector<Point3>& lpts) {
+  ArenaScope scope;
+  ArenaUnorderedMap<int, int> ids;
+  ids.reserve(trs.size() * 2);
+  ltrs.clear();
+  ltrs.reserve(trs.size());
+  lpts.clear();
+  for (auto& tr : trs) {
+    Triangle t;
+    for (int k = 0; k < 3; k++) {
+      auto it = ids.emplace(tr[k], int(lpts.size()));
+      if (it.second == true) {
+        lpts.push_back(lspts[tr[k]]);
+      }
+      t[k] = it.first->second;
+    }
+    ltrs.push_back(t);
+  }
+}
+
+static double           _weld_steps = 0.0;
+static QuantisationGrid _weld_grid = {{1.0, 1.0, 1.0}, {0.0, 0.0, 0.0}};
+
+void set_weld_tolerance(double steps, const QuantisationGrid& grid) {
+  _weld_steps = steps;
+  _weld_grid = grid;
+}
+
+double get_weld_tolerance() {
+  return _weld_steps;
+}
+
+const QuantisationGrid& get_weld_grid() {
+  return _weld_grid;
+}
+
+//-- welds the points at most steps apart on the quantisation grid (to the
+//-- first one found). The points are compared with their integer grid
+//-- coordinates, so the result does not depend on the rounding of the
+//-- transform: with steps < 1 only the points on the same grid point are
+//-- welded, with steps = 1 also those one step apart along an axis. A
+//-- spatial hash of cells of ceil(steps) grid units: only the 27 cells
+//-- around a point are searched. trs are renumbered and the points
+//-- compacted. returns the number of points welded; the triangles that
+//-- become degenerate are left to repair_polygon_soup()
+std::size_t weld_points(std::vector<Triangle>& trs, std::vector<Point3>& lspts, double steps, const QuantisationGrid& grid) {
+  if ( (steps <= 0.0) || (lspts.empty() == true) ) {
+    return 0;
+  }
+  auto cellkey = [](std::int64_t x, std::int64_t y, std::int64_t z) {
+    std::uint64_t h = std::uint64_t(x) * 73856093ULL;
+    h ^= std::uint64_t(y) * 19349663ULL;
+    h ^= std::uint64_t(z) * 83492791ULL;
+    return h;
+  };
+  double sqsteps = steps * steps;
+  std::int64_t cellsize = std::max(std::int64_t(1), std::int64_t(std::ceil(steps)));
+  ArenaScope scope;
+  ArenaVector<std::array<std::int64_t, 3>> ilspts(lspts.size());
+  for (std::size_t i = 0; i < lspts.size(); i++) {
+    const Point3& p = lspts[i];
+    ilspts[i] = {std::llround((p.x() - grid.origin[0]) / grid.scale[0]),
+                 std::llround((p.y() - grid.origin[1]) / grid.scale[1]),
+                 std::llround((p.z() - grid.origin[2]) / grid.scale[2])};
+  }
+  ArenaUnorderedMultimap<std::uint64_t, int> cells;
+  cells.reserve(lspts.size());
+  ArenaVector<int> newid(lspts.size());
+  ArenaVector<int> kept;
+  std::vector<Point3> welded;
+  welded.reserve(lspts.size());
+  for (std::size_t i = 0; i < lspts.size(); i++) {
+    const std::array<std::int64_t, 3>& g = ilspts[i];
+    std::int64_t cx = (g[0] >= 0) ? (g[0] / cellsize) : -((-g[0] + cellsize - 1) / cellsize);
+    std::int64_t cy = (g[1] >= 0) ? (g[1] / cellsize) : -((-g[1] + cellsize - 1) / cellsize);
+    std::int64_t cz = (g[2] >= 0) ? (g[2] / cellsize) : -((-g[2] + cellsize - 1) / cellsize);
+    int found = -1;
+    for (std::int64_t dx = -1; (dx <= 1) && (found == -1); dx++) {
+      for (std::int64_t dy = -1; (dy <= 1) && (found == -1); dy++) {
+        for (std::int64_t dz = -1; (dz <= 1) && (found == -1); dz++) {
+          auto range = cells.equal_range(cellkey(cx + dx, cy + dy, cz + dz));
+          for (auto it = range.first; it != range.second; ++it) {
+            const std::array<std::int64_t, 3>& o = ilspts[kept[it->second]];
+            std::int64_t ex = g[0] - o[0];
+            std::int64_t ey = g[1] - o[1];
+            std::int64_t ez = g[2] - o[2];
+            //-- an exact integer, compared with a threshold off the lattice
+            if (double(ex * ex + ey * ey + ez * ez) <= sqsteps) {
+              found = it->second;
+              break;
+            }
+          }
+        }
+      }
+    }
+    if (found == -1) {
+      found = int(welded.size());
+      welded.push_back(lspts[i]);
+      kept.push_back(int(i));
+      cells.emplace(cellkey(cx, cy, cz), found);
+    }
+    newid[i] = found;
+  }
+  std::size_t nwelded = lspts.size() - welded.size();
+  if (nwelded > 0) {
+    for (auto& tr : trs) {
+      for (int k = 0; k < 3; k++) {
+        tr[k] = newid[tr[k]];
+      }
+    }
+    lspts.swap(welded);
+  }
+  return nwelded;
+}
+
+struct Point3Hash {
+  std::size_t operator()(const Point3& p) const {
+    std::hash<double> h;
+    std::size_t seed = h(p.x());
+    seed ^= h(p.y()) + 0x9e3779b9 + (seed << 6) + (seed >> 2);
+    seed ^= h(p.z()) + 0x9e3779b9 + (seed << 6) + (seed >> 2);
+    return seed;
+  }
+};
+
+//-- linear pre-check of a soup: true if it is a closed 2-manifold with a
+//-- consistent orientation and nothing that repair_polygon_soup() would
+//-- change, then repair and orientation can be skipped:
+//--   - each directed edge is used once, and its opposite once;
+//--   - no degenerate triangle (repeated or collinear points);
+//--   - no 2 points at the same position (merged by the repair);
+//--   - the vertices are manifold (is_polygon_soup_a_polygon_mesh).
+//-- (the screen for self-intersections is thus limited to what the repair
+//-- would fix, a full test is not cheaper than the repair)
+bool is_closed_oriented_soup(const std::vector<Triangle>& trs, const std::vector<Point3>& lspts) {
+  if (trs.size() < 4) {
+    return false;
+  }
+  ArenaScope scope;
+  ArenaUnorderedMap<std::uint64_t, int> edges;
+  edges.reserve(trs.size() * 3);
+  for (auto& tr : trs) {
+    if ( (tr[0] == tr[1]) || (tr[1] == tr[2]) || (tr[2] == tr[0]) ) {
+      return false;
+    }
+    if (CGAL::collinear(lspts[tr[0]], lspts[tr[1]], lspts[tr[2]]) == true) {
+      return false;
+    }
+    for (int k = 0; k < 3; k++) {
+      std::uint64_t e = (std::uint64_t(std::uint32_t(tr[k])) << 32) | std::uint32_t(tr[(k + 1) % 3]);
+      if (++edges[e] > 1) {
+        return false;
+      }
+    }
+  }
+  for (auto& e : edges) {
+    std::uint64_t opposite = (e.first << 32) | (e.first >> 32);
+    if (edges.count(opposite) == 0) {
+      return false;
+    }
+  }
+  ArenaUnorderedSet<Point3, Point3Hash> positions;
+  positions.reserve(lspts.size());
+  for (auto& p : lspts) {
+    if (positions.insert(p).second == false) {
+      return false;
+    }
+  }
+  return CGAL::Polygon_mesh_processing::is_polygon_soup_a_polygon_mesh(trs);
+}
+
 Polyhedron convex_hull(const std::vector<Point3>& lspts) {
   Polyhedron poly;
   CGAL::convex_hull_3(lspts.begin(), lspts.end(), poly);
@@ -71,24 +284,192 @@ double oobb_volume(std::array<Point3, 8> oobbpts) {
   return vol;
 }
 
-std::vector<std::vector<int>>
+//-- a polygon of a face, only used while it is triangulated
+typedef CGAL::Polygon_2<K, ArenaVector<Point2>> ScratchPolygon2;
+
+//-- ear clipping of a simple polygon, O(n^2) but without building a
+//-- triangulation. left is the turn of a convex vertex (LEFT_TURN if pgn is
+//-- ccw), the ears keep the orientation of pgn and are indices of pgn.
+//-- false if it gets stuck (near-degenerate polygon): use the CDT then.
+static bool ear_clipping(const ScratchPolygon2& pgn, CGAL::Orientation left, ArenaVector<Triangle>& ears) {
+  int n = int(pgn.size());
+  CGAL::Orientation right = CGAL::opposite(left);
+  ArenaVector<int> prev(n);
+  ArenaVector<int> next(n);
+  for (int i = 0; i < n; i++) {
+    prev[i] = (i + n - 1) % n;
+    next[i] = (i + 1) % n;
+  }
+  int remaining = n;
+  int i = 0;
+  int tries = 0;
+  while (remaining > 3) {
+    int a = prev[i];
+    int c = next[i];
+    bool isear = (CGAL::orientation(pgn[a], pgn[i], pgn[c]) == left);
+    if (isear == true) {
+      //-- no other (reflex) vertex in or on the ear
+      for (int k = next[c]; k != a; k = next[k]) {
+        if ( (CGAL::orientation(pgn[prev[k]], pgn[k], pgn[next[k]]) != left) &&
+             (CGAL::orientation(pgn[a], pgn[i], pgn[k]) != right) &&
+             (CGAL::orientation(pgn[i], pgn[c], pgn[k]) != right) &&
+             (CGAL::orientation(pgn[c], pgn[a], pgn[k]) != right) ) {
+          isear = false;
+          break;
+        }
+      }
+    }
+    if (isear == true) {
+      ears.push_back({a, i, c});
+      next[a] = c;
+      prev[c] = a;
+      remaining -= 1;
+      i = c;
+      tries = 0;
+    } else {
+      i = next[i];
+      if (++tries > remaining) {
+        return false;
+      }
+    }
+  }
+  if (CGAL::orientation(pgn[prev[i]], pgn[i], pgn[next[i]]) != left) {
+    return false;
+  }
+  ears.push_back({prev[i], i, next[i]});
+  return true;
+}
+
+static bool _check_triangulation = false;
+static bool _newell_projection = true;
+
+//-- projection of the points of a face to 2D: drop one axis (0, 1, 2) or,
+//-- with axis = -1, to_2d() of a fitted plane
+struct FaceProjection {
+  int     axis;
+  Plane   plane;
+  Point2 operator()(const Point3& p) const {
+    if (axis == 0) {
+      return Point2(p.y(), p.z());
+    } else if (axis == 1) {
+      return Point2(p.z(), p.x());
+    } else if (axis == 2) {
+      return Point2(p.x(), p.y());
+    }
+    return plane.to_2d(p);
+  }
+};
+
+void set_newell_projection(bool newell) {
+  _newell_projection = newell;
+}
+
+//-- ct.is_valid() checks the whole structure of the triangulation, it is
+//-- for debugging only
+void set_check_triangulation(bool check) {
+  _check_triangulation = check;
+}
+
+//-- the triangulation of one face and its scratch, kept by each thread
+struct CTContext {
+  CTFast                          ct;
+  std::vector<CTFast::Face_handle> queue;
+  std::vector<CTFast::Edge>       border;
+};
+
+template <typename T>
+static void triangulate_cdt(T& ct,
+                            const std::vector<std::vector<int>>& lsRings,
+                            const std::vector<Point3>& lspts,
+                            const FaceProjection& proj,
+                            bool reversed,
+                            std::vector<typename T::Face_handle>& queue,
+                            std::vector<typename T::Edge>& border,
+                            std::vector<Triangle>& re) {
+  for (auto& ring : lsRings) {
+    if (ring.empty() == true) {
+      continue;
+    }
+    //-- each vertex is inserted once, the segments link consecutive ones
+    typename T::Vertex_handle v0 = ct.insert(proj(lspts[ring.front()]));
+    v0->id() = ring.front();
+    typename T::Vertex_handle vfirst = v0;
+    for (std::size_t i = 1; i <= ring.size(); i++) {
+      typename T::Vertex_handle v1 = vfirst;
+      if (i < ring.size()) {
+        v1 = ct.insert(proj(lspts[ring[i]]), v0->face());
+        v1->id() = ring[i];
+      }
+      if (v0 != v1) {
+        ct.insert_constraint(v0, v1);
+      }
+      v0 = v1;
+    }
+  }
+  mark_domains(ct, queue, border);
+  if ( (_check_triangulation == true) && (ct.is_valid() == false) ) {
+    return;
+  }
+  for (auto fit = ct.finite_faces_begin(); fit != ct.finite_faces_end(); ++fit) {
+    if (fit->info().in_domain()) {
+      if (reversed) {
+        re.push_back({fit->vertex(0)->id(), fit->vertex(2)->id(), fit->vertex(1)->id()});
+      } else {
+        re.push_back({fit->vertex(0)->id(), fit->vertex(1)->id(), fit->vertex(2)->id()});
+      }
+    }
+  }
+}
+
+//-- the triangulation is tiered, from the cheapest to the most general:
+//--   1. a triangle is kept as is;
+//--   2. a convex ring (no holes) is triangulated as a fan;
+//--   3. a simple ring (no holes) by ear clipping;
+//--   4. the rest (holes, non-simple or near-degenerate rings) with a CDT.
+//-- the triangles have the orientation of the oring in all cases.
+std::vector<Triangle>
 construct_ct_one_face(const std::vector<std::vector<int>>& lsRings, 
                       const std::vector<Point3>& lspts)
 {
-  std::vector<std::vector<int>> re;
+  std::vector<Triangle> re;
+  //-- the scratch of the face (polygon, ears) is in the arena of the thread
+  ArenaScope scope;
 
-  //-- find best fitted plane (only based on oring)
-  std::vector<Point3> planepts;
-  for (auto& each : lsRings[0]) {
-    planepts.push_back(lspts[each]);
+  if ( (lsRings.size() == 1) && (lsRings[0].size() == 3) ) {
+    const std::vector<int>& r = lsRings[0];
+    if (CGAL::collinear(lspts[r[0]], lspts[r[1]], lspts[r[2]]) == false) {
+      re.push_back({r[0], r[1], r[2]});
+      return re;
+    }
+  }
+
+  //-- projection plane (only based on oring): drop the dominant axis of the
+  //-- Newell normal, or the best fitted plane if the face is far from planar
+  FaceProjection proj;
+  proj.axis = -1;
+  if (_newell_projection == true) {
+    K::Vector_3 n;
+    double deviation = newell_normal(lsRings[0], lspts, n);
+    double size = std::sqrt(std::sqrt(n.squared_length()) / 2);
+    if ( (size > 0.0) && (deviation <= PLANARITY_TOLERANCE * size) ) {
+      double ax = std::abs(n.x());
+      double ay = std::abs(n.y());
+      double az = std::abs(n.z());
+      proj.axis = (ax >= ay && ax >= az) ? 0 : ((ay >= az) ? 1 : 2);
+    }
+  }
+  if (proj.axis == -1) {
+    std::vector<Point3> planepts;
+    for (auto& each : lsRings[0]) {
+      planepts.push_back(lspts[each]);
+    }
+    proj.plane = get_best_fitted_plane(planepts);
   }
-  Plane bestfitplane = get_best_fitted_plane(planepts);
   //-- check orientation (for good normals for the output, pointing outwards)
   bool reversed = false;
-  Polygon2 pgn;
+  ScratchPolygon2 pgn;
   for (auto& each : lsRings[0]) {
-    Point3 p = lspts[each];
-    pgn.push_back(bestfitplane.to_2d(p));
+    pgn.push_back(proj(lspts[each]));
   }
 
   //-- stop if the oring is not simple (could crash TODO: understand why)
@@ -102,59 +483,85 @@ construct_ct_one_face(const std::vector<std::vector<int>>& lsRings,
   if (pgn.is_counterclockwise_oriented() == false) {
     reversed = true;
   }
-    
-  CT ct;
-  for (auto& ring : lsRings) {
-    //-- make another *closed* ring for simplicity
-    std::vector<int> r2 = ring;
-    r2.push_back(ring.front());
-    std::vector<int>::const_iterator it;
-    std::vector<int>::iterator it2 = std::prev(r2.end());
-    for (it = r2.begin(); it != it2; it++) {
-      Point2 p0 = bestfitplane.to_2d(lspts[*it]);
-      CT::Vertex_handle v0 = ct.insert(p0);
-      v0->id() = *it;
-      auto it3 = it;
-      it3++;
-      Point2 p1 = bestfitplane.to_2d(lspts[*it3]);
-      CT::Vertex_handle v1 = ct.insert(p1);
-      v1->id() = *it3;
-      if (v0 != v1) {
-        ct.insert_constraint(v0, v1);
+
+  if ( (lsRings.size() == 1) && (pgn.size() >= 3) && (pgn.is_simple() == true) ) {
+    const std::vector<int>& r = lsRings[0];
+    CGAL::Orientation left = (reversed == true) ? CGAL::RIGHT_TURN : CGAL::LEFT_TURN;
+    std::size_t n = pgn.size();
+    bool convex = true;
+    for (std::size_t i = 0; i < n; i++) {
+      if (CGAL::orientation(pgn[(i + n - 1) % n], pgn[i], pgn[(i + 1) % n]) != left) {
+        convex = false;
+        break;
       }
     }
-  }
-  mark_domains(ct); 
-  if (!ct.is_valid()) 
-    return re;
-  for (CT::Finite_faces_iterator fit = ct.finite_faces_begin();
-       fit != ct.finite_faces_end(); 
-       ++fit) 
-  {
-    if (fit->info().in_domain()) {
-      std::vector<int> t;
-      t.push_back(fit->vertex(0)->id());
-      if (reversed) {
-        t.push_back(fit->vertex(2)->id());
-        t.push_back(fit->vertex(1)->id());
-      } else {
-        t.push_back(fit->vertex(1)->id());
-        t.push_back(fit->vertex(2)->id());
+    if (convex == true) {
+      for (std::size_t i = 1; i + 1 < n; i++) {
+        re.push_back({r[0], r[i], r[i + 1]});
+      }
+      return re;
+    }
+    ArenaVector<Triangle> ears;
+    if (ear_clipping(pgn, left, ears) == true) {
+      for (auto& ear : ears) {
+        re.push_back({r[ear[0]], r[ear[1]], r[ear[2]]});
       }
-      re.push_back(t);
+      return re;
     }
   }
-  // if (pgn.is_simple() == false) {
-  //   std::cout << "trs:";
-  //   for (auto& t: re)
-  //     for (auto& i: t)
-  //       std::cout << i << " ";
-  //   std::cout << std::endl;
-  // }
+    
+  //-- the CDT of the thread is reused; exact constructions only if
+  //-- constraints intersect (rare: self-intersecting rings)
+  static thread_local CTContext ctx;
+  try {
+    ctx.ct.clear();
+    triangulate_cdt(ctx.ct, lsRings, lspts, proj, reversed, ctx.queue, ctx.border, re);
+  } catch (CTFast::Intersection_of_constraints_exception&) {
+    re.clear();
+    CT ct;
+    std::vector<CT::Face_handle> queue;
+    std::vector<CT::Edge> border;
+    triangulate_cdt(ct, lsRings, lspts, proj, reversed, queue, border, re);
+  }
   return re;
 }
 
 
+//-- normal of a ring with Newell's method (its length is twice the area of the
+//-- ring), in one pass with the centre of the ring. Returns the planarity
+//-- deviation: largest distance of a vertex to the plane (normal, centre)
+double newell_normal(const std::vector<int>& ring, const std::vector<Point3>& lspts, K::Vector_3& normal) {
+  double nx = 0.0, ny = 0.0, nz = 0.0;
+  double cx = 0.0, cy = 0.0, cz = 0.0;
+  std::size_t n = ring.size();
+  for (std::size_t i = 0; i < n; i++) {
+    const Point3& a = lspts[ring[i]];
+    const Point3& b = lspts[ring[(i + 1) % n]];
+    nx += (a.y() - b.y()) * (a.z() + b.z());
+    ny += (a.z() - b.z()) * (a.x() + b.x());
+    nz += (a.x() - b.x()) * (a.y() + b.y());
+    cx += a.x();
+    cy += a.y();
+    cz += a.z();
+  }
+  normal = K::Vector_3(nx, ny, nz);
+  double len = std::sqrt(nx * nx + ny * ny + nz * nz);
+  if ( (n == 0) || (len == 0.0) ) {
+    return 0.0;
+  }
+  cx /= n;
+  cy /= n;
+  cz /= n;
+  double deviation = 0.0;
+  for (auto& i : ring) {
+    const Point3& p = lspts[i];
+    double d = std::abs((p.x() - cx) * nx + (p.y() - cy) * ny + (p.z() - cz) * nz) / len;
+    deviation = std::max(deviation, d);
+  }
+  return deviation;
+}
+
+
 Plane get_best_fitted_plane(const std::vector<Point3> &lspts)
 {
   Plane p;
@@ -183,51 +590,60 @@ Plane get_best_fitted_plane(const std::vector<Point3> &lspts)
   }
 }
 
-void mark_domains(CT& ct,
-  CT::Face_handle start,
-  int index,
-  std::list<CT::Edge>& border) 
-{
-  if (start->info().nesting_level != -1) {
-    return;
-  }
-  std::list<CT::Face_handle> queue;
-  queue.push_back(start);
-  while (!queue.empty()) {
-    CT::Face_handle fh = queue.front();
-    queue.pop_front();
-    if (fh->info().nesting_level == -1) {
-      fh->info().nesting_level = index;
-      for (int i = 0; i < 3; i++) {
-        CT::Edge e(fh, i);
-        CT::Face_handle n = fh->neighbor(i);
-        if (n->info().nesting_level == -1) {
-          if (ct.is_constrained(e)) border.push_back(e);
-          else queue.push_back(n);
-        }
-      }
-    }
-  }
-}
-
 //explore set of facets connected with non constrained edges,
 //and attribute to each such set a nesting level.
 //We start from facets incident to the infinite vertex, with a nesting
 //level of 0. Then we recursively consider the non-explored facets incident 
 //to constrained edges bounding the former set and increase the nesting level by 1.
 //Facets in the domain are those with an odd nesting level.
-void mark_domains(CT& ct) {
-  for (CT::All_faces_iterator it = ct.all_faces_begin(); it != ct.all_faces_end(); ++it) {
+//(queue and border are scratch, passed to be reused from face to face)
+template <typename T>
+void mark_domains(T& ct, std::vector<typename T::Face_handle>& queue, std::vector<typename T::Edge>& border) {
+  for (auto it = ct.all_faces_begin(); it != ct.all_faces_end(); ++it) {
     it->info().nesting_level = -1;
   }
-  std::list<CT::Edge> border;
-  mark_domains(ct, ct.infinite_face(), 0, border);
-  while (!border.empty()) {
-    CT::Edge e = border.front();
-    border.pop_front();
-    CT::Face_handle n = e.first->neighbor(e.second);
-    if (n->info().nesting_level == -1) {
-      mark_domains(ct, n, e.first->info().nesting_level + 1, border);
+  queue.clear();
+  border.clear();
+  border.push_back(typename T::Edge(ct.infinite_face(), -1));
+  int index = 0;
+  //-- border is processed as a FIFO, then the levels grow monotonically
+  for (std::size_t b = 0; b < border.size(); b++) {
+    typename T::Face_handle start;
+    if (border[b].second == -1) {
+      start = border[b].first;
+    } else {
+      start = border[b].first->neighbor(border[b].second);
+      index = border[b].first->info().nesting_level + 1;
+    }
+    if (start->info().nesting_level != -1) {
+      continue;
+    }
+    queue.clear();
+    queue.push_back(start);
+    while (queue.empty() == false) {
+      typename T::Face_handle fh = queue.back();
+      queue.pop_back();
+      if (fh->info().nesting_level == -1) {
+        fh->info().nesting_level = index;
+        for (int i = 0; i < 3; i++) {
+          typename T::Edge e(fh, i);
+          typename T::Face_handle n = fh->neighbor(i);
+          if (n->info().nesting_level == -1) {
+            if (ct.is_constrained(e)) border.push_back(e);
+            else queue.push_back(n);
+          }
+        }
+      }
     }
   }
-}  
\ No newline at end of file
+}
+
+template <typename T>
+void mark_domains(T& ct) {
+  std::vector<typename T::Face_handle> queue;
+  std::vector<typename T::Edge> border;
+  mark_domains(ct, queue, border);
+}
+
+template void mark_domains<CT>(CT& ct);
+template void mark_domains<CTFast>(CTFast& ct);
@@ -3,12 +3,35 @@
 
 #include "definitions.h"
 
+//-- largest distance of a vertex to the plane of the Newell normal, relative
+//-- to the size of the ring, for which the ring is considered planar
+const double PLANARITY_TOLERANCE = 0.01;
+
+//-- area and volume of a closed soup (divergence theorem), volume > 0 if the
+//-- soup is oriented outwards
+struct SoupMoments {
+  double                area;
+  double                volume;
+};
+
+//-- the quantisation of the vertices (transform of the CityJSON): a vertex
+//-- is origin + scale * (its integer coordinates)
+struct QuantisationGrid {
+  std::array<double, 3> scale;
+  std::array<double, 3> origin;
+};
 
 Polyhedron            convex_hull(const std::vector<Point3>& lspts);
 Plane                 get_best_fitted_plane(const std::vector<Point3> &lspts);
-double                mu(std::vector<Point3>& shellpts, std::vector<std::vector<int>>& trs, const std::vector<Point3>& lspts);
-double                area_shell(std::vector<std::vector<int>>& trs, const std::vector<Point3>& lspts);
-double                volume_shell(std::vector<std::vector<int>>& trs, const std::vector<Point3>& lspts);
+double                newell_normal(const std::vector<int>& ring, const std::vector<Point3>& lspts, K::Vector_3& normal);
+double                mu(std::vector<Point3>& shellpts, std::vector<Triangle>& trs, const std::vector<Point3>& lspts);
+SoupMoments           soup_moments(const std::vector<Triangle>& trs, const std::vector<Point3>& lspts);
+double                area_shell(std::vector<Triangle>& trs, const std::vector<Point3>& lspts);
+double                volume_shell(std::vector<Triangle>& trs, const std::vector<Point3>& lspts);
+void                  compact_soup(const std::vector<Triangle>& trs, const std::vector<Point3>& lspts,
+                                   std::vector<Triangle>& ltrs, std::vector<Point3>& lpts);
+std::size_t           weld_points(std::vector<Triangle>& trs, std::vector<Point3>& lspts, double steps, const QuantisationGrid& grid);
+bool                  is_closed_oriented_soup(const std::vector<Triangle>& trs, const std::vector<Point3>& lspts);
 double                oobb_area(std::array<Point3, 8> oobbpts);
 double                oobb_volume(std::array<Point3, 8> oobbpts);
 K::Iso_cuboid_3       aabb(const std::vector<Point3>& lspts);
@@ -16,10 +39,17 @@ std::array<Point3, 8> oobb(const std::vector<Point3>& lspts);
 
 double                get_sphere_radius_from_volume(double vol);
 
-void                  mark_domains(CT& ct);
-void                  mark_domains(CT& ct, CT::Face_handle start, int index, std::list<CT::Edge>& border);
-std::vector<std::vector<int>>
-                      construct_ct_one_face(const std::vector<std::vector<int>>& lsRings, 
+template <typename T>
+void                  mark_domains(T& ct);
+template <typename T>
+void                  mark_domains(T& ct, std::vector<typename T::Face_handle>& queue, std::vector<typename T::Edge>& border);
+void                  set_check_triangulation(bool check);
+void                  set_newell_projection(bool newell);
+//-- welding of the vertices of the shells, in steps of the grid (0: none)
+void                  set_weld_tolerance(double steps, const QuantisationGrid& grid);
+double                get_weld_tolerance();
+const QuantisationGrid& get_weld_grid();
+std::vector<Triangle> construct_ct_one_face(const std::vector<std::vector<int>>& lsRings, 
                                             const std::vector<Point3>& lspts);
 
 #endif 
\ No newline at end of file
@@ -3,11 +3,26 @@
 #include <fstream>
 #include <string>
 #include <set>
+#include <algorithm>
+#include <iterator>
+#include <array>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <stdexcept>
+#include <thread>
 
 #include "json.hpp"
 #include "definitions.h"
 #include "geomtools.h"
 #include "Shell.h"
+#include "Scheduler.h"
+#include "parallel.h"
+#include "Pipeline.h"
+#include "sharding.h"
+#include "WorkerPool.h"
 
 #include <boost/program_options.hpp>
 
@@ -15,7 +30,75 @@ using json = nlohmann::json;
 
 void    list_all_vertices(json& j);
 std::vector<Point3> get_coordinates(const json& j, bool translate = true);
-void    calculate_metrics(std::vector<Point3>& lspts, const json &j);
+void    print_header();
+void    calculate_metrics(std::vector<Point3>& lspts, const json &j, const std::unordered_set<std::string>& selected, std::uint64_t seed, int nthreads, bool isolate, std::size_t memorylimit, bool verbose);
+void    calculate_metrics_pipeline(std::vector<Point3>& lspts, const json &j, const std::unordered_set<std::string>& selected, std::uint64_t seed, std::array<int, 4> stageworkers, int queuesize, std::size_t memorylimit, bool verbose);
+std::size_t parse_memory(const std::string& s);
+std::uint64_t shell_seed(std::uint64_t seed, const std::string& id);
+std::vector<Triangle> triangulate_solid(const json& g, const std::vector<Point3>& lspts);
+
+//-- the CSV row of a shell, and the volume deviation of its simplified proxy
+//-- (negative if it was not simplified), reported by the RowWriter
+struct MetricsRow {
+  std::string                     row;
+  double                          deviation;
+};
+MetricsRow metrics_row(const std::string& id, Shell& s);
+
+//-- one Solid going through the stages of the pipeline
+struct ShellItem {
+  std::size_t                     index;
+  std::string                     id;
+  const json*                     geom;
+  std::vector<Triangle>           trs;
+  std::size_t                     memory;
+  //-- released with the item at the latest (failed or skipped shells too),
+  //-- declared before the shell so that it is destroyed after it
+  std::unique_ptr<MemoryAdmission> admission;
+  std::unique_ptr<Shell>          shell;
+  std::string                     row;
+  double                          deviation = -1.0;
+};
+
+//-- the CSV rows in the order of the input, each one written as soon as all
+//-- the rows before it are done (a failed shell has an empty row)
+class RowWriter {
+public:
+  RowWriter(std::ostream& os) : _os(os), _next(0) {}
+
+  void done(std::size_t index, std::string row) {
+    std::lock_guard<std::mutex> lock(_mutex);
+    _pending[index] = std::move(row);
+    while ( (_pending.empty() == false) && (_pending.begin()->first == _next) ) {
+      if (_pending.begin()->second.empty() == false) {
+        _os << _pending.begin()->second << std::endl;
+      }
+      _pending.erase(_pending.begin());
+      _next++;
+    }
+  }
+
+  void failed(const std::string& msg) {
+    std::lock_guard<std::mutex> lock(_mutex);
+    std::cerr << "failed: " << msg << std::endl;
+  }
+
+  //-- the volume metrics of the shell are on its simplified proxy
+  void simplified(const std::string& id, double deviation) {
+    if (deviation < 0.0) {
+      return;
+    }
+    std::lock_guard<std::mutex> lock(_mutex);
+    std::cerr << id << ": volume metrics on a simplified mesh, volume deviation "
+              << 100.0 * deviation << "%" << std::endl;
+  }
+
+private:
+  std::ostream&                       _os;
+  std::mutex                          _mutex;
+  std::size_t                         _next;
+  std::map<std::size_t, std::string>  _pending;
+};
 
 std::set<std::string> metrics = {
   "area",
@@ -38,9 +121,41 @@ std::set<std::string> metrics = {
 };
 
 int main(int argc, const char * argv[]) {
+  //-- bumo merge shard0.csv shard1.csv ...
+  if ( (argc > 1) && (std::string(argv[1]) == "merge") ) {
+    if (argc < 3) {
+      std::cerr << "Usage: bumo merge shard0.csv shard1.csv ..." << std::endl;
+      return 1;
+    }
+    return merge_shards(std::vector<std::string>(argv + 2, argv + argc), std::cout);
+  }
+
   std::string ifile; 
   bool bTranslate = false;
   bool bVerbose = false;
+  int nThreads = int(std::thread::hardware_concurrency());
+  bool bPipeline = false;
+  bool bIsolate = false;
+  std::string sStageWorkers;
+  std::array<int, 4> stageWorkers;
+  int queueSize = 16;
+  std::string sShard;
+  std::string sShardKey = "id";
+  std::string sProjection = "newell";
+  double weldSteps = 0.5;
+  std::size_t holeMaxBorder = 200;
+  double holeTime = 10.0;
+  double holeTimeEach = 2.0;
+  double wrapAccuracy = 0.3;
+  double wrapTime = 30.0;
+  double windingCell = 0.5;
+  double simplifyTolerance = 0.0;
+  std::size_t simplifyMinFaces = 20000;
+  int shard = 0;
+  int nShards = 1;
+  std::uint64_t seed = 0;
+  std::string sMemoryLimit;
+  std::size_t memoryLimit = 0;
 
   try {
     namespace po = boost::program_options;
@@ -50,6 +165,29 @@ int main(int argc, const char * argv[]) {
       ("metrics", po::bool_switch(), "List the metrics calculated")
       ("translate", po::bool_switch(), "Use transform/translate (default=false)")
       ("verbose", po::bool_switch(), "Verbose output")
+      ("threads", po::value<int>(&nThreads), "Number of threads (default=all cores)")
+      ("pipeline", po::bool_switch(), "Staged pipeline: triangulate, repair, sample, metrics and write overlap")
+      ("isolate", po::bool_switch(), "Process the shells in worker processes: a crashing shell is reported as failed and the run continues")
+      ("stage-workers", po::value<std::string>(&sStageWorkers), "Workers of the pipeline stages triangulate,repair,sample,metrics (default=threads/4 each)")
+      ("queue-size", po::value<int>(&queueSize), "Capacity of the queues between the pipeline stages (default=16)")
+      ("memory-limit", po::value<std::string>(&sMemoryLimit), "Admit shells only while their estimated memory stays under this, eg 8G or 500M (default=none)")
+      ("seed", po::value<std::uint64_t>(&seed), "Seed of the random sampling (default=0)")
+      ("shard", po::value<std::string>(&sShard), "Process only the shard i/n of the CityObjects (0 <= i < n)")
+      ("shard-key", po::value<std::string>(&sShardKey), "Partition the CityObjects by 'id' (hash) or 'spatial' (default=id)")
+      ("projection", po::value<std::string>(&sProjection), "Projection of the surfaces to triangulate them: 'newell' (drop the dominant axis) or 'lsq' (best fitted plane) (default=newell)")
+      ("weld", po::value<double>(&weldSteps), "Weld the vertices of a shell at most this many steps of transform/scale apart, compared on the integer grid. The default (0.5) only merges the vertices on the same grid point, which the repair would merge anyway; welding the near-duplicates one step apart (more shells closed, but 1-step edges collapse) is opt-in with --weld 1 (0: no welding)")
+      ("hole-max-border", po::value<std::size_t>(&holeMaxBorder), "Holes with a longer border (in edges) are left open, the shell is then measured with the winding number (or wrapped with --wrap-open) (default=200)")
+      ("hole-time", po::value<double>(&holeTime), "Time (s) for all the holes of one shell, checked before each hole (default=10)")
+      ("hole-time-each", po::value<double>(&holeTimeEach), "Time (s) of one hole, checked between its tiers: a hole over it does not go to the next, slower tier; one tier is not interrupted, --hole-max-border bounds it (default=2)")
+      ("fair-holes", po::bool_switch(), "Allow the refine+fair filling for the non-planar holes (slow)")
+      ("wrap-open", po::bool_switch(), "Alpha-wrap the open shells (instead of using the winding number for inside/outside)")
+      ("wrap-accuracy", po::value<double>(&wrapAccuracy), "Accuracy (offset, m) of the alpha wrap of the open shells (default=0.3)")
+      ("wrap-time", po::value<double>(&wrapTime), "Time (s) for the wrap(s) of one shell; with CGAL 6+ a wrap is stopped at that time, before it only between the coarse-to-fine wraps (default=30)")
+      ("wrap-coarse-first", po::bool_switch(), "Wrap coarse first and refine only while the volume changes")
+      ("winding-cell", po::value<double>(&windingCell), "Size (m) of the cells counted for the volume of the open shells with the winding number, at most 1/32 of the shell; the error is at most about the area times it, and beyond 16M cells they grow (default=0.5)")
+      ("simplify", po::value<double>(&simplifyTolerance), "Volume queries of detailed shells on a mesh simplified within this distance (m) (default=0, none)")
+      ("simplify-min-faces", po::value<std::size_t>(&simplifyMinFaces), "Only shells with more faces are simplified (default=20000)")
+      ("check-triangulation", po::bool_switch(), "Check the validity of each constrained triangulation (slow, for debugging)")
       ;
     po::options_description pohidden("Hidden options");
     pohidden.add_options()
@@ -67,6 +205,7 @@ int main(int argc, const char * argv[]) {
 
     if (vm.count("help")) {
       std::cout << "Usage: bumo myfile.city.json" << std::endl;
+      std::cout << "       bumo merge shard0.csv shard1.csv ..." << std::endl;
       std::cout << pomain << std::endl;
       return 1;
     }
@@ -96,6 +235,65 @@ int main(int argc, const char * argv[]) {
     if (vm["verbose"].as<bool>() == true) {
       bVerbose = true;
     }
+    if (vm["pipeline"].as<bool>() == true) {
+      bPipeline = true;
+    }
+    if (vm["isolate"].as<bool>() == true) {
+      bIsolate = true;
+    }
+    if ( (sProjection != "newell") && (sProjection != "lsq") ) {
+      throw std::invalid_argument("--projection is either 'newell' or 'lsq'");
+    }
+    set_newell_projection(sProjection == "newell");
+    set_hole_filling(holeMaxBorder, holeTime, holeTimeEach, vm["fair-holes"].as<bool>());
+    if (wrapAccuracy <= 0.0) {
+      throw std::invalid_argument("--wrap-accuracy must be > 0");
+    }
+    set_wrap_parameters(wrapAccuracy, wrapTime, vm["wrap-coarse-first"].as<bool>());
+    set_wrap_open_shells(vm["wrap-open"].as<bool>());
+    if (windingCell <= 0.0) {
+      throw std::invalid_argument("--winding-cell must be > 0");
+    }
+    set_winding_cell(windingCell);
+    set_simplification(simplifyTolerance, simplifyMinFaces);
+    if (vm["check-triangulation"].as<bool>() == true) {
+      set_check_triangulation(true);
+    }
+    if ( (bPipeline == true) && (bIsolate == true) ) {
+      throw std::invalid_argument("--isolate cannot be used with --pipeline");
+    }
+    if (vm.count("shard")) {
+      std::size_t pos = sShard.find('/');
+      if (pos == std::string::npos) {
+        throw std::invalid_argument("--shard expects i/n");
+      }
+      shard = std::stoi(sShard.substr(0, pos));
+      nShards = std::stoi(sShard.substr(pos + 1));
+      if ( (nShards < 1) || (shard < 0) || (shard >= nShards) ) {
+        throw std::invalid_argument("--shard expects i/n with 0 <= i < n");
+      }
+    }
+    if ( (sShardKey != "id") && (sShardKey != "spatial") ) {
+      throw std::invalid_argument("--shard-key is either 'id' or 'spatial'");
+    }
+    if (vm.count("memory-limit")) {
+      memoryLimit = parse_memory(sMemoryLimit);
+    }
+    stageWorkers.fill(std::max(1, nThreads / 4));
+    if (vm.count("stage-workers")) {
+      std::istringstream ss(sStageWorkers);
+      std::string tok;
+      int i = 0;
+      while (std::getline(ss, tok, ',')) {
+        if (i == 4) {
+          throw std::invalid_argument("--stage-workers expects 4 values");
+        }
+        stageWorkers[i++] = std::max(1, std::stoi(tok));
+      }
+      if (i != 4) {
+        throw std::invalid_argument("--stage-workers expects 4 values");
+      }
+    }
   } 
   catch(std::exception& e) {
     std::cerr << "Error: " << e.what() << "\n";
@@ -107,69 +305,324 @@ int main(int argc, const char * argv[]) {
   input >> j;
   input.close();
 
+  //-- no TBB in a process that forks workers (they init their own)
+  set_nthreads(nThreads, !bIsolate);
   std::vector<Point3> lspts = get_coordinates(j, bTranslate);
+  //-- the vertices are welded on the grid of the transform (the translate is
+  //-- only its origin if the coordinates were translated); by default only
+  //-- those on the same grid point, the near-duplicates only with --weld 1
+  QuantisationGrid grid;
+  for (int k = 0; k < 3; k++) {
+    grid.scale[k] = j["transform"]["scale"][k].get<double>();
+    grid.origin[k] = (bTranslate == true) ? j["transform"]["translate"][k].get<double>() : 0.0;
+  }
+  set_weld_tolerance(weldSteps, grid);
 
-  calculate_metrics(lspts, j);
+  std::unordered_set<std::string> selected = select_shard(j, lspts, shard, nShards, sShardKey == "spatial");
+
+  print_header();
+  try {
+    if (bPipeline == true) {
+      calculate_metrics_pipeline(lspts, j, selected, seed, stageWorkers, queueSize, memoryLimit, bVerbose);
+    } else {
+      calculate_metrics(lspts, j, selected, seed, nThreads, bIsolate, memoryLimit, bVerbose);
+    }
+  } catch (std::exception& e) {
+    std::cerr << "Error: " << e.what() << std::endl;
+    return 1;
+  }
+  if (bVerbose == true) {
+    print_hole_stats(std::cerr);
+    //-- (with --isolate the shells are in the worker processes: not counted)
+    print_sample_stats(std::cerr);
+  }
 
   return 0;
 }
 
 
-void calculate_metrics(std::vector<Point3>& lspts, const json &j) {
-  
+void print_header() {
   //-- header CSV output
   std::cout << "id[lod],";
   for (auto& metric : metrics) {
     std::cout << metric << ",";
   }
   std::cout << std::endl;
+}
+
+
+//-- the samples of a shell depend only on the global seed and its id[lod],
+//-- so identical input gives identical output, whatever the threads/shards
+std::uint64_t shell_seed(std::uint64_t seed, const std::string& id) {
+  return stable_hash(std::to_string(seed) + "/" + id);
+}
+
+
+//-- "8G", "500M", "2048K" or a number of MB
+std::size_t parse_memory(const std::string& s) {
+  std::size_t pos;
+  double v = std::stod(s, &pos);
+  std::string unit = s.substr(pos);
+  double mult = 1024.0 * 1024.0;
+  if ( (unit == "G") || (unit == "g") || (unit == "GB") ) {
+    mult = 1024.0 * 1024.0 * 1024.0;
+  } else if ( (unit == "K") || (unit == "k") || (unit == "KB") ) {
+    mult = 1024.0;
+  } else if ( (unit.empty() == false) && (unit != "M") && (unit != "m") && (unit != "MB") ) {
+    throw std::invalid_argument("--memory-limit: unknown unit " + unit);
+  }
+  if (v <= 0.0) {
+    throw std::invalid_argument("--memory-limit must be positive");
+  }
+  return std::size_t(v * mult);
+}
 
-  //-- process each CityObjects (and each of its geoms)
+
+void calculate_metrics(std::vector<Point3>& lspts, const json &j, const std::unordered_set<std::string>& selected, std::uint64_t seed, int nthreads, bool isolate, std::size_t memorylimit, bool verbose) {
+
+  //-- triangulate each CityObjects (and each of its geoms)
+  std::vector<std::string> ids;
+  std::vector<std::vector<Triangle>> shells;
+  std::vector<double> costs;
+  std::vector<std::size_t> memory;
   for (auto& co : j["CityObjects"].items()) {
+    if (selected.count(co.key()) == 0) {
+      continue;
+    }
     for (auto& g : co.value()["geometry"]) {
       if (g["type"] != "Solid") {
         continue;
       }
-      std::vector<std::vector<int>> trs;
-      for (int i = 0; i < g["boundaries"].size(); i++) {
-        for (int j = 0; j < g["boundaries"][i].size(); j++) {
-          std::vector<std::vector<int>> gb = g["boundaries"][i][j];
-          //-- save the triangles
-          std::vector<std::vector<int>> tris = construct_ct_one_face(gb, lspts);
-          for (auto& each : tris) {
-            trs.push_back(each);
-          }
-        }
-      }
+      std::vector<Triangle> trs = triangulate_solid(g, lspts);
       if (trs.empty() == false) {
-        std::cout << std::setprecision(3) << std::fixed;
-        Shell s = Shell(trs, lspts);
-        std::cout << co.key() << "[" << g["lod"].get<std::string>() << "]" << ",";   
-        std::cout << s.area() << ",";
-        std::cout << s.circumference() << ",";
-        std::cout << s.cohesion() << ",";
-        std::cout << s.convexity() << ",";
-        std::cout << s.cubeness() << ",";
-        std::cout << s.cuboidindex() << ",";
-        std::cout << s.depth() << ","; 
-        std::cout << s.dispersion() << ",";
-        std::cout << s.fractality() << ",";
-        std::cout << s.girth() << ",";
-        std::cout << s.hemisphericality() << ",";
-        std::cout << s.proximity() << ",";
-        std::cout << s.range() << ",";
-        std::cout << s.rectangularity() << ",";
-        std::cout << s.roughness() << ",";
-        std::cout << s.spin() << ",";
-        std::cout << s.volume() << ",";
-        std::cout << std::endl;     
-        
-        //-- save to OBJ each geom
-        // std::string output_name = "/Users/hugo/temp/" + co.key() + ".off";
-        // s.write_off(output_name);
+        ids.push_back(co.key() + "[" + g["lod"].get<std::string>() + "]");
+        ShellEstimate e = estimate_shell(trs, lspts);
+        costs.push_back(e.cost);
+        memory.push_back(e.memory);
+        shells.push_back(std::move(trs));
+      }
+    }
+  }
+
+  //-- compute the metrics of the shells, most expensive first; the rows are
+  //-- written in the order of the input as soon as they are contiguous, a
+  //-- shell that fails is reported and the others go on
+  RowWriter writer(std::cout);
+  if (isolate == true) {
+    std::vector<std::string> rows(shells.size());
+    std::vector<std::uint64_t> seeds;
+    for (auto& id : ids) {
+      seeds.push_back(shell_seed(seed, id));
+    }
+    std::vector<double> deviations;
+    std::vector<std::string> failures;
+    WorkerPool pool(nthreads, memorylimit,
+      [](const std::string& id, std::uint64_t seed, std::vector<Triangle>& trs, std::vector<Point3>& pts, double& deviation) {
+        Shell s(std::move(trs), std::move(pts));
+        s.sample(seed);
+        MetricsRow r = metrics_row(id, s);
+        deviation = r.deviation;
+        return r.row;
+      });
+    pool.run(ids, seeds, shells, lspts, costs, memory, rows, deviations, failures);
+    for (auto& f : failures) {
+      writer.failed(f);
+    }
+    for (std::size_t i = 0; i < rows.size(); i++) {
+      writer.simplified(ids[i], deviations[i]);
+      writer.done(i, std::move(rows[i]));
+    }
+  } else {
+    MemoryBudget budget(memorylimit);
+    Scheduler scheduler(nthreads, &budget);
+    scheduler.run(costs, memory, [&](std::size_t i) {
+      MetricsRow r;
+      r.deviation = -1.0;
+      try {
+        Shell s(shells[i], lspts);
+        s.sample(shell_seed(seed, ids[i]));
+        r = metrics_row(ids[i], s);
+      } catch (std::exception& e) {
+        writer.failed(ids[i] + ": " + e.what());
+      } catch (...) {
+        writer.failed(ids[i] + ": unknown exception");
       }
+      writer.simplified(ids[i], r.deviation);
+      writer.done(i, std::move(r.row));
+    });
+    if (verbose == true) {
+      std::cerr << "peak estimated memory of the shells: " << budget.peak() / (1024 * 1024) << "MB" << std::endl;
+    }
+  }
+}
+
+
+//-- the surfaces are triangulated in parallel by chunks, each chunk in its
+//-- own buffer; the buffers are then concatenated at known offsets
+std::vector<Triangle> triangulate_solid(const json& g, const std::vector<Point3>& lspts) {
+  const std::size_t chunksize = 64; //-- surfaces
+  std::vector<const json*> surfaces;
+  for (auto& shell : g["boundaries"]) {
+    for (auto& surface : shell) {
+      surfaces.push_back(&surface);
     }
   }
+  std::size_t nchunks = (surfaces.size() + chunksize - 1) / chunksize;
+  std::vector<std::vector<Triangle>> chunks(nchunks);
+  parallel_for_blocks(nchunks, [&](std::size_t c) {
+    std::size_t end = std::min(surfaces.size(), (c + 1) * chunksize);
+    for (std::size_t i = c * chunksize; i < end; i++) {
+      std::vector<std::vector<int>> gb = *surfaces[i];
+      //-- save the triangles
+      std::vector<Triangle> tris = construct_ct_one_face(gb, lspts);
+      std::move(tris.begin(), tris.end(), std::back_inserter(chunks[c]));
+    }
+  });
+  std::vector<std::size_t> offsets(nchunks + 1, 0);
+  for (std::size_t c = 0; c < nchunks; c++) {
+    offsets[c + 1] = offsets[c] + chunks[c].size();
+  }
+  std::vector<Triangle> trs(offsets.back());
+  parallel_for_blocks(nchunks, [&](std::size_t c) {
+    std::move(chunks[c].begin(), chunks[c].end(), trs.begin() + offsets[c]);
+  });
+  return trs;
+}
+
+
+//-- each stage has its own workers and a bounded input queue, so that the
+//-- stages overlap and a slow stage throttles the ones before it.
+//-- rows are written in input order as soon as they are contiguous.
+//-- (the JSON file itself is still read and parsed in one go before)
+void calculate_metrics_pipeline(std::vector<Point3>& lspts, const json &j, const std::unordered_set<std::string>& selected, std::uint64_t seed, std::array<int, 4> stageworkers, int queuesize, std::size_t memorylimit, bool verbose) {
+  //-- a shell is admitted before its repair and leaves after its metrics (or
+  //-- when its item is dropped, if a stage failed)
+  MemoryBudget budget(memorylimit);
+  Pipeline<std::unique_ptr<ShellItem>> pipeline(std::size_t(std::max(1, queuesize)));
+  pipeline.source("parse", [&](const std::function<void(std::unique_ptr<ShellItem>)>& emit) {
+    std::size_t index = 0;
+    for (auto& co : j["CityObjects"].items()) {
+      if (selected.count(co.key()) == 0) {
+        continue;
+      }
+      for (auto& g : co.value()["geometry"]) {
+        if (g["type"] != "Solid") {
+          continue;
+        }
+        std::unique_ptr<ShellItem> item(new ShellItem());
+        item->index = index++;
+        item->id = co.key() + "[" + g["lod"].get<std::string>() + "]";
+        item->geom = &g;
+        emit(std::move(item));
+      }
+    }
+  });
+  //-- a shell that fails in a stage is reported, its shell and its memory are
+  //-- dropped and it goes on to the write stage without row (Pipeline::fail
+  //-- is only for the errors of the pipeline itself)
+  RowWriter writer(std::cout);
+  auto guarded = [&](std::unique_ptr<ShellItem>& item, const std::function<void()>& f) {
+    std::string error;
+    try {
+      f();
+      return;
+    } catch (std::exception& e) {
+      error = e.what();
+    } catch (...) {
+      error = "unknown exception";
+    }
+    writer.failed(item->id + ": " + error);
+    std::vector<Triangle>().swap(item->trs);
+    item->shell.reset();
+    item->admission.reset();
+    item->row.clear();
+    item->deviation = -1.0;
+  };
+  pipeline.stage("triangulate", stageworkers[0], [&](std::unique_ptr<ShellItem>& item) {
+    guarded(item, [&]() {
+      item->trs = triangulate_solid(*item->geom, lspts);
+      if (item->trs.empty() == false) {
+        item->memory = estimate_shell(item->trs, lspts).memory;
+      }
+    });
+  });
+  pipeline.stage("repair", stageworkers[1], [&](std::unique_ptr<ShellItem>& item) {
+    guarded(item, [&]() {
+      if (item->trs.empty() == false) {
+        item->admission.reset(new MemoryAdmission(budget, item->memory));
+        item->shell.reset(new Shell(item->trs, lspts));
+      }
+      std::vector<Triangle>().swap(item->trs);
+    });
+  });
+  pipeline.stage("sample", stageworkers[2], [&](std::unique_ptr<ShellItem>& item) {
+    guarded(item, [&]() {
+      if (item->shell != nullptr) {
+        item->shell->sample(shell_seed(seed, item->id));
+      }
+    });
+  });
+  pipeline.stage("metrics", stageworkers[3], [&](std::unique_ptr<ShellItem>& item) {
+    guarded(item, [&]() {
+      if (item->shell != nullptr) {
+        MetricsRow r = metrics_row(item->id, *item->shell);
+        item->row = std::move(r.row);
+        item->deviation = r.deviation;
+        item->shell.reset();
+        item->admission.reset();
+      }
+    });
+  });
+  pipeline.stage("write", 1, [&](std::unique_ptr<ShellItem>& item) {
+    writer.simplified(item->id, item->deviation);
+    writer.done(item->index, std::move(item->row));
+  });
+  //-- the stage workers take their share of the thread budget
+  int claimed = claim_threads(pipeline.nworkers() - 1);
+  try {
+    pipeline.run();
+  } catch (...) {
+    return_threads(claimed);
+    throw;
+  }
+  return_threads(claimed);
+  if (verbose == true) {
+    pipeline.report(std::cerr);
+    std::cerr << "peak estimated memory of the shells: " << budget.peak() / (1024 * 1024) << "MB" << std::endl;
+  }
+}
+
+
+MetricsRow metrics_row(const std::string& id, Shell& s) {
+  std::ostringstream row;
+  row << std::setprecision(3) << std::fixed;
+  row << id << ",";
+  row << s.area() << ",";
+  row << s.circumference() << ",";
+  row << s.cohesion() << ",";
+  row << s.convexity() << ",";
+  row << s.cubeness() << ",";
+  row << s.cuboidindex() << ",";
+  row << s.depth() << ","; 
+  row << s.dispersion() << ",";
+  row << s.fractality() << ",";
+  row << s.girth() << ",";
+  row << s.hemisphericality() << ",";
+  row << s.proximity() << ",";
+  row << s.range() << ",";
+  row << s.rectangularity() << ",";
+  row << s.roughness() << ",";
+  row << s.spin() << ",";
+  row << s.volume() << ",";
+  
+  MetricsRow r;
+  r.deviation = (s.is_simplified() == true) ? s.simplification_deviation() : -1.0;
+  
+  //-- save to OBJ each geom
+  // std::string output_name = "/Users/hugo/temp/" + id + ".off";
+  // s.write_off(output_name);
+  r.row = row.str();
+  return r;
 }
 
 
@@ -0,0 +1,197 @@
+#include "parallel.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#ifdef CGAL_LINKED_WITH_TBB
+#include <tbb/blocked_range.h>
+#include <tbb/global_control.h>
+#include <tbb/parallel_for.h>
+#include <tbb/task_arena.h>
+#include <tbb/task_group.h>
+#endif
+
+
+static std::atomic<int> _nthreads(1);
+static std::atomic<int> _nbusy(1); //-- the main thread
+
+#ifdef CGAL_LINKED_WITH_TBB
+static std::unique_ptr<tbb::global_control> _control;
+static std::unique_ptr<tbb::task_arena>     _arena;
+#endif
+
+
+void set_nthreads(int n, bool usetbb) {
+  _nthreads = std::max(1, n);
+  _nbusy = 1;
+#ifdef CGAL_LINKED_WITH_TBB
+  _arena.reset();
+  _control.reset();
+  if (usetbb == true) {
+    _control.reset(new tbb::global_control(tbb::global_control::max_allowed_parallelism, _nthreads));
+    _arena.reset(new tbb::task_arena(_nthreads));
+  }
+#endif
+}
+
+int get_nthreads() {
+  return _nthreads;
+}
+
+//-- claims up to n idle threads of the budget, returns how many were granted
+int claim_threads(int n) {
+  int busy = _nbusy.load();
+  while (true) {
+    int granted = std::max(0, std::min(n, _nthreads - busy));
+    if (granted == 0) {
+      return 0;
+    }
+    if (_nbusy.compare_exchange_weak(busy, busy + granted)) {
+      return granted;
+    }
+  }
+}
+
+void return_threads(int n) {
+  _nbusy -= n;
+}
+
+//-- the object-level workers: tasks of the arena with TBB (so that the kernels
+//-- and CGAL use the same threads), otherwise std::threads
+void parallel_workers(int n, const std::function<void(int)>& f) {
+#ifdef CGAL_LINKED_WITH_TBB
+  if (_arena != nullptr) {
+    _arena->execute([&]() {
+      tbb::task_group g;
+      for (int i = 0; i < n; i++) {
+        g.run([&f, i]() { f(i); });
+      }
+      g.wait();
+    });
+    return;
+  }
+#endif
+  std::vector<std::thread> workers;
+  for (int i = 0; i < n; i++) {
+    workers.emplace_back([&f, i]() { f(i); });
+  }
+  for (auto& w : workers) {
+    w.join();
+  }
+}
+
+void parallel_for_blocks(std::size_t nblocks, const std::function<void(std::size_t)>& f) {
+#ifdef CGAL_LINKED_WITH_TBB
+  if ( (_arena != nullptr) && (nblocks > 1) ) {
+    //-- isolated: a thread waiting for the blocks may not pick up another shell
+    _arena->execute([&]() {
+      tbb::this_task_arena::isolate([&]() {
+        tbb::parallel_for(tbb::blocked_range<std::size_t>(0, nblocks, 1),
+                          [&](const tbb::blocked_range<std::size_t>& r) {
+                            for (std::size_t b = r.begin(); b != r.end(); ++b) {
+                              f(b);
+                            }
+                          });
+      });
+    });
+    return;
+  }
+#endif
+  int nhelpers = 0;
+  if (nblocks > 1) {
+    nhelpers = claim_threads(int(std::min(nblocks, std::size_t(_nthreads))) - 1);
+  }
+  if (nhelpers == 0) {
+    for (std::size_t b = 0; b < nblocks; b++) {
+      f(b);
+    }
+    return;
+  }
+  std::atomic<std::size_t> next(0);
+  std::exception_ptr eptr = nullptr;
+  std::mutex emutex;
+  auto work = [&]() {
+    std::size_t b;
+    while ((b = next++) < nblocks) {
+      try {
+        f(b);
+      } catch (...) {
+        std::lock_guard<std::mutex> lock(emutex);
+        if (eptr == nullptr) {
+          eptr = std::current_exception();
+        }
+      }
+    }
+  };
+  std::vector<std::thread> helpers;
+  for (int i = 0; i < nhelpers; i++) {
+    helpers.emplace_back(work);
+  }
+  work();
+  for (auto& h : helpers) {
+    h.join();
+  }
+  return_threads(nhelpers);
+  if (eptr != nullptr) {
+    std::rethrow_exception(eptr);
+  }
+}
+
+//-- without the isolation, a thread waiting in the tbb::parallel_for of CGAL
+//-- could start another top-level worker task (another shell) on its stack,
+//-- which can block in the MemoryBudget while the first one waits for it
+void parallel_isolated(const std::function<void()>& f) {
+#ifdef CGAL_LINKED_WITH_TBB
+  if (_arena != nullptr) {
+    _arena->execute([&]() {
+      tbb::this_task_arena::isolate([&]() { f(); });
+    });
+    return;
+  }
+#endif
+  f();
+}
+
+//-- pairwise sum of v[lo, hi)
+static double pairwise_sum(const std::vector<double>& v, std::size_t lo, std::size_t hi) {
+  if (hi - lo == 0) {
+    return 0.0;
+  }
+  if (hi - lo == 1) {
+    return v[lo];
+  }
+  std::size_t mid = lo + (hi - lo) / 2;
+  return pairwise_sum(v, lo, mid) + pairwise_sum(v, mid, hi);
+}
+
+//-- sum of f(0) ... f(n-1) with a fixed shape: a compensated (Kahan-Babuska)
+//-- sum inside each block of blocksize terms, then a pairwise sum of the blocks.
+//-- the shape only depends on n and blocksize, so the result is bit-identical
+//-- whether the blocks are summed serially or in parallel.
+double parallel_sum(std::size_t n, const std::function<double(std::size_t)>& f, std::size_t blocksize) {
+  std::size_t nblocks = (n + blocksize - 1) / blocksize;
+  std::vector<double> partial(nblocks, 0.0);
+  parallel_for_blocks(nblocks, [&](std::size_t b) {
+    std::size_t end = std::min(n, (b + 1) * blocksize);
+    double s = 0.0;
+    double c = 0.0;
+    for (std::size_t i = b * blocksize; i < end; i++) {
+      double x = f(i);
+      double t = s + x;
+      if (std::abs(s) >= std::abs(x)) {
+        c += (s - t) + x;
+      } else {
+        c += (x - t) + s;
+      }
+      s = t;
+    }
+    partial[b] = s + c;
+  });
+  return pairwise_sum(partial, 0, nblocks);
+}
@@ -0,0 +1,30 @@
+#ifndef __parallel__
+#define __parallel__
+
+#include <cstddef>
+#include <functional>
+
+//-- number of items (samples) in one block of the parallel kernels. The blocks
+//-- do not depend on the number of threads, and the partial results are
+//-- combined in block order, so the results are the same with 1 or n threads.
+//-- A kernel goes parallel only once it has more than one block.
+const std::size_t     BLOCK_SIZE = 4096;
+
+//-- budget of threads shared by the object-level workers and the kernels.
+//-- with TBB, set_nthreads() also bounds the task arena in which everything
+//-- runs, including the parallel algorithms of CGAL (CONCURRENCY_TAG).
+//-- usetbb=false keeps TBB uninitialised (a process that will fork)
+void    set_nthreads(int n, bool usetbb = true);
+int     get_nthreads();
+int     claim_threads(int n);
+void    return_threads(int n);
+
+void    parallel_workers(int n, const std::function<void(int)>& f);
+void    parallel_for_blocks(std::size_t nblocks, const std::function<void(std::size_t)>& f);
+//-- runs f (that uses the parallel algorithms of CGAL, CONCURRENCY_TAG) in the
+//-- arena, isolated: a thread waiting in it may not pick up another shell
+void    parallel_isolated(const std::function<void()>& f);
+//-- reproducible sum (compensated in blocks + pairwise), use it for all the reductions
+double  parallel_sum(std::size_t n, const std::function<double(std::size_t)>& f, std::size_t blocksize = BLOCK_SIZE);
+
+#endif
@@ -0,0 +1,160 @@
+#include "sharding.h"
+
+#include <algorithm>
+#include <fstream>
+#include <limits>
+#include <memory>
+#include <queue>
+#include <tuple>
+
+
+//-- FNV-1a: unlike std::hash it is the same on every platform/compiler,
+//-- so that a CityObject ends up in the same shard on every node
+std::uint64_t stable_hash(const std::string& s) {
+  std::uint64_t h = 14695981039346656037ULL;
+  for (unsigned char c : s) {
+    h ^= c;
+    h *= 1099511628211ULL;
+  }
+  return h;
+}
+
+
+static void collect_vertices(const json& b, std::vector<int>& ids) {
+  if (b.is_array()) {
+    for (auto& e : b) {
+      collect_vertices(e, ids);
+    }
+  } else if (b.is_number_integer()) {
+    ids.push_back(b.get<int>());
+  }
+}
+
+static std::uint32_t morton_2d(std::uint32_t x, std::uint32_t y) {
+  std::uint32_t code = 0;
+  for (int i = 0; i < 16; i++) {
+    code |= ((x >> i) & 1) << (2 * i);
+    code |= ((y >> i) & 1) << (2 * i + 1);
+  }
+  return code;
+}
+
+
+//-- the ids of the CityObjects of shard (0 <= shard < nshards).
+//-- the shards form a partition of the CityObjects: either by hashing the id,
+//-- or by cutting in nshards equal parts the CityObjects sorted along a
+//-- Morton curve (of the centre of their vertices), which keeps the shards compact.
+std::unordered_set<std::string> select_shard(const json& j, const std::vector<Point3>& lspts, int shard, int nshards, bool spatial) {
+  std::unordered_set<std::string> re;
+  if (nshards <= 1) {
+    for (auto& co : j["CityObjects"].items()) {
+      re.insert(co.key());
+    }
+    return re;
+  }
+  if (spatial == false) {
+    for (auto& co : j["CityObjects"].items()) {
+      if (int(stable_hash(co.key()) % std::uint64_t(nshards)) == shard) {
+        re.insert(co.key());
+      }
+    }
+    return re;
+  }
+  //-- centre of each CityObject
+  std::vector<std::string> ids;
+  std::vector<std::pair<double, double>> centres;
+  double inf = std::numeric_limits<double>::max();
+  double xmin = inf, ymin = inf, xmax = -inf, ymax = -inf;
+  for (auto& co : j["CityObjects"].items()) {
+    std::vector<int> vs;
+    if (co.value().contains("geometry")) {
+      for (auto& g : co.value()["geometry"]) {
+        collect_vertices(g["boundaries"], vs);
+      }
+    }
+    double cx = 0.0, cy = 0.0;
+    for (auto& v : vs) {
+      cx += lspts[v].x();
+      cy += lspts[v].y();
+    }
+    if (vs.empty() == false) {
+      cx /= vs.size();
+      cy /= vs.size();
+      xmin = std::min(xmin, cx);
+      ymin = std::min(ymin, cy);
+      xmax = std::max(xmax, cx);
+      ymax = std::max(ymax, cy);
+    }
+    ids.push_back(co.key());
+    centres.push_back(std::make_pair(cx, cy));
+  }
+  //-- sort along the Morton curve (ties by id) and cut in nshards
+  double dx = std::max(xmax - xmin, 1e-9);
+  double dy = std::max(ymax - ymin, 1e-9);
+  std::vector<std::pair<std::uint32_t, std::size_t>> codes;
+  for (std::size_t i = 0; i < ids.size(); i++) {
+    double fx = std::min(std::max((centres[i].first - xmin) / dx, 0.0), 1.0);
+    double fy = std::min(std::max((centres[i].second - ymin) / dy, 0.0), 1.0);
+    codes.push_back(std::make_pair(morton_2d(std::uint32_t(fx * 65535), std::uint32_t(fy * 65535)), i));
+  }
+  std::sort(codes.begin(), codes.end(),
+            [&ids](const std::pair<std::uint32_t, std::size_t>& a, const std::pair<std::uint32_t, std::size_t>& b) {
+              return std::tie(a.first, ids[a.second]) < std::tie(b.first, ids[b.second]);
+            });
+  for (std::size_t r = 0; r < codes.size(); r++) {
+    if (int(r * nshards / codes.size()) == shard) {
+      re.insert(ids[codes[r].second]);
+    }
+  }
+  return re;
+}
+
+
+//-- the CityObjects are processed in the order of their ids (the CityJSON
+//-- object is a std::map) and a CityObject is always in one shard: a k-way
+//-- merge on the id of the rows gives back the order of the input
+int merge_shards(const std::vector<std::string>& files, std::ostream& out) {
+  std::vector<std::unique_ptr<std::ifstream>> ins;
+  std::string header;
+  for (auto& f : files) {
+    ins.emplace_back(new std::ifstream(f));
+    if (ins.back()->is_open() == false) {
+      std::cerr << "Error: cannot open " << f << std::endl;
+      return 1;
+    }
+    std::string h;
+    std::getline(*ins.back(), h);
+    if (header.empty() == true) {
+      header = h;
+    } else if (h != header) {
+      std::cerr << "Error: " << f << " does not have the same columns" << std::endl;
+      return 1;
+    }
+  }
+  auto key = [](const std::string& line) {
+    std::string first = line.substr(0, line.find(','));
+    return first.substr(0, first.rfind('['));
+  };
+  typedef std::tuple<std::string, std::size_t, std::string> Row; //-- id, file, line
+  std::priority_queue<Row, std::vector<Row>, std::greater<Row>> heap;
+  auto next = [&](std::size_t i) {
+    std::string line;
+    while (std::getline(*ins[i], line)) {
+      if (line.empty() == false) {
+        heap.push(std::make_tuple(key(line), i, line));
+        return;
+      }
+    }
+  };
+  for (std::size_t i = 0; i < ins.size(); i++) {
+    next(i);
+  }
+  out << header << std::endl;
+  while (heap.empty() == false) {
+    Row r = heap.top();
+    heap.pop();
+    out << std::get<2>(r) << std::endl;
+    next(std::get<1>(r));
+  }
+  return 0;
+}
@@ -0,0 +1,16 @@
+#ifndef __sharding__
+#define __sharding__
+
+#include "definitions.h"
+#include "json.hpp"
+
+#include <cstdint>
+#include <unordered_set>
+
+using json = nlohmann::json;
+
+std::uint64_t                   stable_hash(const std::string& s);
+std::unordered_set<std::string> select_shard(const json& j, const std::vector<Point3>& lspts, int shard, int nshards, bool spatial);
+int                             merge_shards(const std::vector<std::string>& files, std::ostream& out);
+
+#endif